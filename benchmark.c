@@ -1,34 +1,345 @@
+/* For preadv2(), pwritev2(), and the RWF_* flags. */
+#define _GNU_SOURCE
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
 #include "benchmark.h"
+#include "crc32c.h"
+#include "histogram.h"
+#include "live.h"
 #include "params.h"
 #include "prng.h"
+#include "slowlog.h"
 
 pthread_barrier_t barrier;
 
-/* Atomic counters. */
+/* Atomic counters for the shared namespace. */
 static long num_operations;
-static long path_counter;
+static size_t cleanup_cursor;
 
-static pthread_rwlock_t files_lock = PTHREAD_RWLOCK_INITIALIZER;
-static long *files_array;
-static size_t files_size, files_capacity;
+struct target *targets;
+unsigned int num_targets;
 
-ssize_t read_full(int fd, void *buf, size_t count)
+enum file_location {
+	FILE_TOP,
+	FILE_NEW,
+	FILE_CUR,
+};
+
+/* Maildir info flags, in the order they must appear in a file name. */
+static const char maildir_flags[] = "DFPRST";
+#define MAILDIR_NUM_FLAGS 6
+#define MAILDIR_FLAG_SEEN (1 << 4)
+
+static const char * const maildir_dirs[] = {"tmp", "new", "cur"};
+
+struct benchmark_file {
+	/* Current file name. */
+	long name;
+	/*
+	 * Name the file was created with, which is recorded in verify headers
+	 * and doesn't change when the file is renamed or linked.
+	 */
+	long id;
+	unsigned char location;
+	unsigned char flags;
+	unsigned short target;
+	/* Size the file was created with. */
+	size_t size;
+};
+
+#define MANIFEST_PATH ".omark-manifest"
+#define MANIFEST_TMP_PATH ".omark-manifest.tmp"
+/* Number of files to stat when checking a manifest. */
+#define MANIFEST_SAMPLES 1024
+
+/* Private subdirectory of each thread in a partitioned namespace. */
+#define PARTITION_FORMAT "p%d"
+
+/*
+ * A set of files and the counters for naming new ones. The shared table is
+ * used by all of the threads, so it is protected by a lock and its counters are
+ * updated atomically. A partition belongs to a single thread and needs
+ * neither.
+ */
+struct file_table {
+	bool shared;
+	pthread_rwlock_t lock;
+	struct benchmark_file *files;
+	size_t size, capacity;
+	long next_name;
+	uint64_t next_generation;
+	unsigned long next_target;
+	/*
+	 * Directory of the partition in each target, or NULL if the files are
+	 * directly in the targets.
+	 */
+	int *dirfds;
+	/* Share of max_operations of a partition's thread. */
+	unsigned long max_operations;
+};
+
+static struct file_table shared_files = {
+	.shared = true,
+	.lock = PTHREAD_RWLOCK_INITIALIZER,
+};
+static struct file_table *partitions;
+static int num_partitions;
+
+static int num_file_tables(void)
+{
+	return partitions ? num_partitions : 1;
+}
+
+static struct file_table *file_table(int i)
+{
+	return partitions ? &partitions[i] : &shared_files;
+}
+
+static void files_rdlock(struct file_table *table)
+{
+	if (table->shared)
+		pthread_rwlock_rdlock(&table->lock);
+}
+
+static void files_wrlock(struct file_table *table)
+{
+	if (table->shared)
+		pthread_rwlock_wrlock(&table->lock);
+}
+
+static void files_unlock(struct file_table *table)
+{
+	if (table->shared)
+		pthread_rwlock_unlock(&table->lock);
+}
+
+static long next_name(struct file_table *table)
+{
+	if (table->shared)
+		return __atomic_fetch_add(&table->next_name, 1,
+					  __ATOMIC_SEQ_CST);
+	return table->next_name++;
+}
+
+static uint64_t next_generation(struct file_table *table)
+{
+	if (table->shared)
+		return __atomic_fetch_add(&table->next_generation, 1,
+					  __ATOMIC_RELAXED);
+	return table->next_generation++;
+}
+
+static unsigned long next_target(struct file_table *table)
+{
+	if (table->shared)
+		return __atomic_fetch_add(&table->next_target, 1,
+					  __ATOMIC_RELAXED);
+	return table->next_target++;
+}
+
+/* Directory which holds a table's files in a target. */
+static int table_dirfd(const struct file_table *table, unsigned int target)
+{
+	return table->dirfds ? table->dirfds[target] : targets[target].dirfd;
+}
+
+/* Hot files, which all of the threads write to at once, in the first target. */
+#define HOT_FILE_FORMAT "hot%lu"
+
+/* Sizes the hot files were created with, which in-place updates stay within. */
+static size_t *hot_file_sizes;
+
+/* Sizes of the initial files, created or loaded from the manifest. */
+static struct histogram initial_file_sizes;
+
+/*
+ * Open file description locks exclude other threads of the same process, not
+ * only other processes. Without them, check_params() rejects hot-lock fcntl.
+ */
+#ifdef F_OFD_SETLKW
+#define HOT_FILE_SETLKW F_OFD_SETLKW
+#else
+#define HOT_FILE_SETLKW F_SETLKW
+#endif
+
+/* Most segments submitted with one vectored system call. */
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define MAX_IO_SEGMENTS IOV_MAX
+#else
+#define MAX_IO_SEGMENTS 1024
+#endif
+/* Largest buffer for vectored I/O, which limits the segments for big blocks. */
+#define MAX_IO_BUFFER (4 * 1024 * 1024)
+
+static size_t io_segments(void)
+{
+	size_t segments;
+
+	if (io_mode == IO_BLOCK)
+		return 1;
+	segments = MAX_IO_BUFFER / block_size;
+	if (segments > MAX_IO_SEGMENTS)
+		return MAX_IO_SEGMENTS;
+	return segments ? segments : 1;
+}
+
+/* Bytes transferred by one system call at most. */
+static size_t io_size(void)
+{
+	return io_segments() * block_size;
+}
+
+/*
+ * With verify, records are checksummed a buffer at a time, so the buffer holds
+ * many system calls' worth of records to keep the timing overhead low.
+ */
+#define VERIFY_BUFFER (256 * 1024)
+
+size_t io_buffer_size(void)
+{
+	size_t size = io_size();
+
+	if (verify && size < VERIFY_BUFFER)
+		size = VERIFY_BUFFER - VERIFY_BUFFER % size;
+	return size;
+}
+
+/* Did fallocate, copy_file_range, or FICLONE turn out to be unsupported? */
+static bool fallocate_unsupported;
+static bool copy_file_range_unsupported;
+static bool ficlone_unsupported;
+
+/* Remember that the filesystem doesn't support something and warn once. */
+static void set_unsupported(bool *unsupported, const char *message)
+{
+	if (!__atomic_exchange_n(unsupported, true, __ATOMIC_RELAXED))
+		fprintf(stderr, "%s\n", message);
+}
+
+static bool is_unsupported(bool *unsupported)
+{
+	return __atomic_load_n(unsupported, __ATOMIC_RELAXED);
+}
+
+#ifdef __linux__
+/* Did nowait fail with EOPNOTSUPP for reads ([0]) or writes ([1])? */
+static bool nowait_unsupported[2];
+
+static int rwf_flags(unsigned int flags)
+{
+	int rwf = 0;
+
+	if (flags & RW_NOWAIT)
+		rwf |= RWF_NOWAIT;
+	if (flags & RW_DSYNC)
+		rwf |= RWF_DSYNC;
+	if (flags & RW_SYNC)
+		rwf |= RWF_SYNC;
+	if (flags & RW_HIPRI)
+		rwf |= RWF_HIPRI;
+	return rwf;
+}
+#endif
+
+/*
+ * Read or write up to count bytes at the file position with a single system
+ * call: read() or write() in block mode, or readv() or writev() with
+ * block-sized segments in vectored mode. With rw-flags, preadv2() or
+ * pwritev2() is used instead, and I/O which would block with nowait is
+ * retried without it.
+ */
+static ssize_t transfer(struct benchmark_thread *thread, int fd, char *buf,
+			size_t count, bool writing)
+{
+	struct iovec iov[MAX_IO_SEGMENTS];
+	int segments = 0;
+	ssize_t ret;
+
+	if (writing)
+		thread->results.write_syscalls++;
+	else
+		thread->results.read_syscalls++;
+
+	if (io_mode == IO_BLOCK && !rw_flags)
+		return writing ? write(fd, buf, count) : read(fd, buf, count);
+
+	for (size_t offset = 0; offset < count && segments < MAX_IO_SEGMENTS;
+	     offset += block_size) {
+		iov[segments].iov_base = buf + offset;
+		iov[segments].iov_len = (count - offset < block_size ?
+					 count - offset : block_size);
+		segments++;
+	}
+
+#ifdef __linux__
+	if (rw_flags) {
+		unsigned int flags = rw_flags;
+
+		if (__atomic_load_n(&nowait_unsupported[writing],
+				    __ATOMIC_RELAXED))
+			flags &= ~RW_NOWAIT;
+		/* An offset of -1 means the file position, including O_APPEND. */
+		ret = (writing ?
+		       pwritev2(fd, iov, segments, -1, rwf_flags(flags)) :
+		       preadv2(fd, iov, segments, -1, rwf_flags(flags)));
+		if (ret == -1 && (flags & RW_NOWAIT) &&
+		    (errno == EAGAIN || errno == EOPNOTSUPP)) {
+			/*
+			 * Buffered writes don't support nowait on many
+			 * filesystems, so stop trying after the first failure.
+			 */
+			if (errno == EOPNOTSUPP &&
+			    !__atomic_exchange_n(&nowait_unsupported[writing],
+						 true, __ATOMIC_RELAXED)) {
+				fprintf(stderr, "nowait is not supported for %s; ignoring it\n",
+					writing ? "writes" : "reads");
+			} else {
+				thread->results.nowait_retries++;
+			}
+			flags &= ~RW_NOWAIT;
+			if (writing) {
+				thread->results.write_syscalls++;
+				ret = pwritev2(fd, iov, segments, -1,
+					       rwf_flags(flags));
+			} else {
+				thread->results.read_syscalls++;
+				ret = preadv2(fd, iov, segments, -1,
+					      rwf_flags(flags));
+			}
+		}
+		return ret;
+	}
+#endif
+	ret = writing ? writev(fd, iov, segments) : readv(fd, iov, segments);
+	return ret;
+}
+
+static ssize_t read_full(struct benchmark_thread *thread, int fd, void *buf,
+			 size_t count)
 {
 	ssize_t total_read = 0;
 
 	while (count > 0) {
 		ssize_t ret;
 
-		ret = read(fd, buf, count);
+		ret = transfer(thread, fd, buf, count, false);
 		if (ret == -1) {
 			if (errno == EINTR)
 				continue;
@@ -44,14 +355,15 @@ ssize_t read_full(int fd, void *buf, size_t count)
 	return total_read;
 }
 
-ssize_t write_full(int fd, void *buf, size_t count)
+static ssize_t write_full(struct benchmark_thread *thread, int fd, void *buf,
+			  size_t count)
 {
 	ssize_t total_written = 0;
 
 	while (count > 0) {
 		ssize_t ret;
 
-		ret = write(fd, buf, count);
+		ret = transfer(thread, fd, buf, count, true);
 		if (ret == -1) {
 			if (errno == EINTR)
 				continue;
@@ -65,218 +377,1522 @@ ssize_t write_full(int fd, void *buf, size_t count)
 	return total_written;
 }
 
-static int write_to_file(struct benchmark_thread *thread, int fd, size_t size)
+static inline uint64_t monotonic_nsecs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * UINT64_C(1000000000) + ts.tv_nsec;
+}
+
+static uint32_t verify_checksum(const char *record, size_t length)
+{
+	return crc32c(0, record + offsetof(struct verify_header, length),
+		      length - offsetof(struct verify_header, length));
+}
+
+/* Fill in the checksums of the records in a buffer, timing them all at once. */
+static void checksum_records(struct benchmark_thread *thread, char *buf,
+			     size_t length)
+{
+	uint64_t start = monotonic_nsecs();
+	struct verify_header header;
+
+	for (size_t offset = 0; offset < length; offset += header.length) {
+		memcpy(&header, buf + offset, VERIFY_HEADER_SIZE);
+		header.crc = verify_checksum(buf + offset, header.length);
+		memcpy(buf + offset, &header, VERIFY_HEADER_SIZE);
+	}
+	thread->results.checksum_nsecs += monotonic_nsecs() - start;
+}
+
+/*
+ * How much of a filled buffer to write with one system call. With verify,
+ * only whole records are written at once so that concurrent appends can't
+ * split them.
+ */
+static size_t write_size(const char *buf, size_t length)
+{
+	struct verify_header header;
+	size_t size = 0;
+
+	if (!verify)
+		return length < io_size() ? length : io_size();
+	while (size < length) {
+		memcpy(&header, buf + size, VERIFY_HEADER_SIZE);
+		if (size + header.length > io_size())
+			break;
+		size += header.length;
+	}
+	return size;
+}
+
+/*
+ * Size of the next chunk to write. With verify, every chunk must be big enough
+ * to hold a record header, so the last two chunks are split unevenly if
+ * necessary.
+ */
+static size_t next_chunk_size(size_t size)
 {
+	if (size <= block_size)
+		return size;
+	if (verify && size - block_size < VERIFY_HEADER_SIZE)
+		return size - VERIFY_HEADER_SIZE;
+	return block_size;
+}
+
+/*
+ * Append size bytes to the file, which starts at the given offset. Returns the
+ * number of bytes written or -1 on error.
+ */
+static ssize_t write_to_file(struct benchmark_thread *thread, int fd,
+			     long file_id, off_t offset, size_t size)
+{
+	size_t capacity = io_buffer_size();
+	struct verify_header header;
+	size_t written = 0;
 	ssize_t ret;
 
 	if (block_aligned)
 		size = size - (size % block_size);
 
-	while (size > block_size) {
-		prng_bytes(&thread->prng, thread->buffer, block_size);
-		ret = write_full(fd, thread->buffer, block_size);
-		if (ret == -1) {
-			perror("write");
+	if (verify) {
+		if (size > 0 && size < VERIFY_HEADER_SIZE)
+			size = VERIFY_HEADER_SIZE;
+		header.magic = VERIFY_MAGIC;
+		header.reserved = 0;
+		header.file_id = file_id;
+		header.generation = next_generation(thread->files);
+	}
+
+	while (size > 0) {
+		size_t filled = 0;
+
+		/* Fill the buffer with as many chunks as fit and write them. */
+		while (size > 0) {
+			size_t chunk = next_chunk_size(size);
+			char *record = thread->buffer + filled;
+
+			if (filled + chunk > capacity)
+				break;
+			if (verify) {
+				prng_bytes(&thread->prng,
+					   record + VERIFY_HEADER_SIZE,
+					   chunk - VERIFY_HEADER_SIZE);
+				header.length = chunk;
+				header.offset = offset + written + filled;
+				memcpy(record, &header, VERIFY_HEADER_SIZE);
+			} else {
+				prng_bytes(&thread->prng, record, chunk);
+			}
+			filled += chunk;
+			size -= chunk;
+		}
+
+		if (verify)
+			checksum_records(thread, thread->buffer, filled);
+		for (size_t done = 0; done < filled; done += ret) {
+			ret = write_full(thread, fd, thread->buffer + done,
+					 write_size(thread->buffer + done,
+						    filled - done));
+			if (ret == -1) {
+				perror("write");
+				return -1;
+			}
+		}
+		written += filled;
+	}
+
+	return written;
+}
+
+static void verify_error(struct benchmark_thread *thread, long file_id,
+			 off_t offset, const char *what,
+			 const struct verify_header *header)
+{
+	fprintf(stderr,
+		"verify: file %ld offset %lld: %s (magic=0x%08" PRIx32
+		" length=%" PRIu32 " file=%" PRIu64 " offset=%" PRIu64
+		" generation=%" PRIu64 ")\n",
+		file_id, (long long)offset, what, header->magic,
+		header->length, header->file_id, header->offset,
+		header->generation);
+	thread->results.verify_errors++;
+}
+
+/*
+ * Read a file written with verify and check every record in it. A record which
+ * is cut off at the end of the file is being appended by another thread and is
+ * not an error. Returns 0 or -1 on a read error.
+ */
+static int read_verified(struct benchmark_thread *thread, int fd,
+			 long file_id)
+{
+	size_t capacity = io_buffer_size();
+	struct verify_header header;
+	off_t offset = 0;
+	size_t have = 0;
+	ssize_t ret;
+
+	do {
+		size_t consumed = 0;
+		uint64_t start;
+
+		/* Fill the buffer, one system call's worth at a time. */
+		do {
+			size_t count = capacity - have;
+
+			if (count > io_size())
+				count = io_size();
+			ret = read_full(thread, fd, thread->buffer + have,
+					count);
+			if (ret == -1)
+				return -1;
+			thread->results.bytes_read += ret;
+			have += ret;
+		} while (ret > 0 && have < capacity);
+
+		start = monotonic_nsecs();
+		while (have - consumed >= VERIFY_HEADER_SIZE) {
+			const char *record = thread->buffer + consumed;
+
+			memcpy(&header, record, VERIFY_HEADER_SIZE);
+			if (header.magic != VERIFY_MAGIC ||
+			    header.length < VERIFY_HEADER_SIZE ||
+			    header.length > block_size) {
+				/* We can't find the next record, so give up. */
+				verify_error(thread, file_id, offset,
+					     "bad record header", &header);
+				thread->results.checksum_nsecs +=
+					monotonic_nsecs() - start;
+				return 0;
+			}
+			if (have - consumed < header.length)
+				break;
+
+			if (verify_checksum(record, header.length) != header.crc) {
+				verify_error(thread, file_id, offset,
+					     "checksum mismatch", &header);
+			} else if (header.file_id != file_id) {
+				verify_error(thread, file_id, offset,
+					     "wrong file", &header);
+			} else if (header.offset > offset) {
+				/*
+				 * Concurrent appends can push a record past the
+				 * offset its writer expected, but never before
+				 * it.
+				 */
+				verify_error(thread, file_id, offset,
+					     "misplaced record", &header);
+			}
+			thread->results.bytes_verified += header.length;
+			consumed += header.length;
+			offset += header.length;
+		}
+		thread->results.checksum_nsecs += monotonic_nsecs() - start;
+
+		memmove(thread->buffer, thread->buffer + consumed,
+			have - consumed);
+		have -= consumed;
+	} while (ret > 0);
+
+	return 0;
+}
+
+/*
+ * Format the path of a file. Files have numeric names, which are put in the
+ * new/ and cur/ subdirectories of a maildir (with a flags suffix for the
+ * latter) when maildir is enabled.
+ */
+static void format_path(char *path, const struct benchmark_file *file)
+{
+	char flags[MAILDIR_NUM_FLAGS + 1];
+	int n = 0;
+
+	switch (file->location) {
+	case FILE_TOP:
+		snprintf(path, NAME_MAX, "%ld", file->name);
+		break;
+	case FILE_NEW:
+		snprintf(path, NAME_MAX, "new/%ld", file->name);
+		break;
+	case FILE_CUR:
+		for (int i = 0; i < MAILDIR_NUM_FLAGS; i++) {
+			if (file->flags & (1 << i))
+				flags[n++] = maildir_flags[i];
+		}
+		flags[n] = '\0';
+		snprintf(path, NAME_MAX, "cur/%ld:2,%s", file->name, flags);
+		break;
+	}
+}
+
+static int add_file(struct file_table *table,
+		    const struct benchmark_file *file)
+{
+	files_wrlock(table);
+	if (table->size >= table->capacity) {
+		struct benchmark_file *new_array;
+		size_t new_capacity;
+
+		new_capacity = table->capacity * 2 + 1;
+		new_array = realloc(table->files,
+				    sizeof(table->files[0]) * new_capacity);
+		if (!new_array) {
+			perror("realloc");
+			files_unlock(table);
 			return -1;
 		}
-		size -= block_size;
+
+		table->files = new_array;
+		table->capacity = new_capacity;
 	}
+	table->files[table->size++] = *file;
+	files_unlock(table);
 
-	prng_bytes(&thread->prng, thread->buffer, size);
-	ret = write_full(fd, thread->buffer, size);
-	if (ret == -1) {
-		perror("write");
-		return -1;
+	return 0;
+}
+
+/* Mix the bits of a file id (the finalizer of MurmurHash3). */
+static uint64_t hash_id(uint64_t id)
+{
+	id ^= id >> 33;
+	id *= UINT64_C(0xff51afd7ed558ccd);
+	id ^= id >> 33;
+	id *= UINT64_C(0xc4ceb9fe1a85ec53);
+	id ^= id >> 33;
+	return id;
+}
+
+/* Pick the target for a new file. */
+static unsigned int pick_target(struct benchmark_thread *thread, long id)
+{
+	if (num_targets == 1)
+		return 0;
+
+	switch (target_policy) {
+	case TARGET_HASH:
+		return hash_id(id) % num_targets;
+	case TARGET_PER_THREAD:
+		return thread->target;
+	case TARGET_ROUND_ROBIN:
+	default:
+		return next_target(thread->files) % num_targets;
 	}
+}
 
+/*
+ * Allocate the space for a new file without changing its size, so that the
+ * appends which fill it in don't allocate.
+ */
+static int preallocate_file(int fd, size_t size)
+{
+#ifdef __linux__
+	if (size == 0 || is_unsupported(&fallocate_unsupported))
+		return 0;
+	if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size) == -1) {
+		if (errno == EOPNOTSUPP) {
+			set_unsupported(&fallocate_unsupported,
+					"fallocate is not supported; not preallocating");
+			return 0;
+		}
+		perror("fallocate");
+		return -1;
+	}
+#endif
 	return 0;
 }
 
 static int create_file(struct benchmark_thread *thread)
 {
-	char path[NAME_MAX];
-	long path_num;
-	int fd;
+	char path[NAME_MAX], tmp_path[NAME_MAX];
+	struct benchmark_file file;
+	int dirfd, fd;
 	size_t size;
-	int ret;
+	ssize_t ret;
 
-	path_num = __atomic_fetch_add(&path_counter, 1, __ATOMIC_SEQ_CST);
-	snprintf(path, sizeof(path), "%ld", path_num);
+	file.name = next_name(thread->files);
+	file.id = file.name;
+	file.location = maildir ? FILE_NEW : FILE_TOP;
+	file.flags = 0;
+	file.target = pick_target(thread, file.id);
+	thread->op_target = file.target;
+	thread->op_file = file.id;
+	dirfd = table_dirfd(thread->files, file.target);
+	format_path(path, &file);
 
-	fd = open(path, O_CREAT | O_WRONLY | O_APPEND, S_IRUSR | S_IWUSR);
+	/* Maildir delivery writes to tmp/ and then renames into new/. */
+	if (maildir)
+		snprintf(tmp_path, sizeof(tmp_path), "tmp/%ld", file.name);
+
+	fd = openat(dirfd, maildir ? tmp_path : path,
+		    O_CREAT | O_WRONLY | O_TRUNC | O_APPEND, S_IRUSR | S_IWUSR);
 	if (fd == -1) {
 		perror("open");
 		return -1;
 	}
 
-	size = prng_range(&thread->prng, min_file_size, max_file_size + 1);
-	ret = write_to_file(thread, fd, size);
+	size = distribution_sample(&file_size_distribution, &thread->prng);
+	if (preallocate && preallocate_file(fd, size) == -1)
+		ret = -1;
+	else
+		ret = write_to_file(thread, fd, file.id, 0, size);
+	if (ret != -1 && maildir && fsync(fd) == -1) {
+		perror("fsync");
+		ret = -1;
+	}
 	if (close(fd) == -1)
 		perror("close");
 	if (ret == -1)
 		return -1;
 
-	thread->results.bytes_written += size;
-
-	pthread_rwlock_wrlock(&files_lock);
-	if (files_size >= files_capacity) {
-		long *new_array;
-		size_t new_capacity;
-
-		new_capacity = files_capacity * 2 + 1;
-		new_array = realloc(files_array,
-				    sizeof(files_array[0]) * new_capacity);
-		if (!new_array) {
-			perror("realloc");
-			pthread_rwlock_unlock(&files_lock);
-			return -1;
-		}
+	thread->results.bytes_written += ret;
+	histogram_record(&thread->results.file_sizes, ret);
+	file.size = ret;
 
-		files_array = new_array;
-		files_capacity = new_capacity;
+	if (maildir && renameat(dirfd, tmp_path, dirfd, path) == -1) {
+		perror("rename");
+		return -1;
 	}
-	files_array[files_size++] = path_num;
-	pthread_rwlock_unlock(&files_lock);
 
-	return 0;
+	return add_file(thread->files, &file);
 }
 
-/* files_lock must be held. */
-static int pick_file(struct benchmark_thread *thread, char *name_ret,
-		     uint32_t *index_ret)
+/*
+ * Pick a random file of the thread and return the descriptor of its directory
+ * and its path relative to it. The thread's file table must be locked.
+ */
+static int pick_file(struct benchmark_thread *thread, char *path_ret,
+		     struct benchmark_file *file_ret, uint32_t *index_ret)
 {
+	struct file_table *table = thread->files;
 	uint32_t index;
 
-	if (files_size == 0)
+	if (table->size == 0)
 		return -1;
 
-	index = prng_range(&thread->prng, 0, files_size);
-	snprintf(name_ret, NAME_MAX, "%ld", files_array[index]);
+	index = prng_range(&thread->prng, 0, table->size);
+	format_path(path_ret, &table->files[index]);
+	thread->op_target = table->files[index].target;
+	thread->op_file = table->files[index].id;
+	if (file_ret)
+		*file_ret = table->files[index];
 	if (index_ret)
 		*index_ret = index;
 
-	return 0;
+	return table_dirfd(table, table->files[index].target);
 }
 
-static void do_read(struct benchmark_thread *thread)
+static int do_read(struct benchmark_thread *thread)
 {
 	char path[NAME_MAX];
-	int fd;
+	struct benchmark_file file;
+	int dirfd, fd;
 	ssize_t ret;
 
-	pthread_rwlock_rdlock(&files_lock);
-	if (pick_file(thread, path, NULL) == -1) {
-		pthread_rwlock_unlock(&files_lock);
-		return;
+	files_rdlock(thread->files);
+	dirfd = pick_file(thread, path, &file, NULL);
+	if (dirfd == -1) {
+		files_unlock(thread->files);
+		return -1;
 	}
 
-	fd = open(path, O_RDONLY);
-	pthread_rwlock_unlock(&files_lock);
+	fd = openat(dirfd, path, O_RDONLY);
+	files_unlock(thread->files);
 	if (fd == -1) {
 		perror("open");
-		return;
+		return -1;
 	}
 
-	while ((ret = read_full(fd, thread->buffer, block_size)) > 0)
-		thread->results.bytes_read += ret;
+	if (verify) {
+		ret = read_verified(thread, fd, file.id);
+	} else {
+		while ((ret = read_full(thread, fd, thread->buffer,
+					io_size())) > 0)
+			thread->results.bytes_read += ret;
+	}
 	if (ret == -1) {
 		perror("read");
 		if (close(fd) == -1)
 			perror("close");
-		return;
+		return -1;
 	}
 
 	if (close(fd) == -1)
 		perror("close");
 	thread->results.read_operations++;
+	return 0;
 }
 
-static void do_write(struct benchmark_thread *thread)
+/*
+ * Take or release the hot-lock lock on a hot file. With fcntl, a length of 0
+ * locks the whole file.
+ */
+static int hot_file_lock(int fd, off_t start, off_t len, bool lock)
+{
+	struct flock fl = {
+		.l_type = lock ? F_WRLCK : F_UNLCK,
+		.l_whence = SEEK_SET,
+		.l_start = start,
+		.l_len = len,
+	};
+	int ret;
+
+	switch (hot_lock) {
+	case HOT_LOCK_FLOCK:
+		do {
+			ret = flock(fd, lock ? LOCK_EX : LOCK_UN);
+		} while (ret == -1 && errno == EINTR);
+		return ret;
+	case HOT_LOCK_FCNTL:
+		do {
+			ret = fcntl(fd, HOT_FILE_SETLKW, &fl);
+		} while (ret == -1 && errno == EINTR);
+		return ret;
+	case HOT_LOCK_NONE:
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Append to a hot file, like a mail delivery to an mbox, or rewrite part of it
+ * in place, like an update of a shared index. Appends lock the whole file and
+ * updates only the range they write.
+ */
+static int do_hot_write(struct benchmark_thread *thread)
 {
 	char path[NAME_MAX];
+	unsigned long index;
+	off_t offset = 0, lock_len = 0;
+	uint64_t start, locked;
+	bool append;
+	size_t size;
+	ssize_t ret;
 	int fd;
+
+	index = prng_range(&thread->prng, 0, hot_files);
+	append = prng_bool(&thread->prng, hot_append_update_ratio);
+	size = distribution_sample(&write_size_distribution, &thread->prng);
+	if (!append) {
+		size_t hot_size = hot_file_sizes[index];
+
+		if (hot_size > 0)
+			offset = prng_range(&thread->prng, 0, hot_size);
+		if (block_aligned)
+			offset -= offset % block_size;
+		/* A verify record needs room for its header. */
+		if (verify && hot_size - offset < VERIFY_HEADER_SIZE) {
+			offset = (hot_size > VERIFY_HEADER_SIZE ?
+				  hot_size - VERIFY_HEADER_SIZE : 0);
+		}
+		/* Don't let an update extend the file like an append. */
+		if (size > hot_size - offset)
+			size = hot_size - offset;
+		lock_len = size ? size : 1;
+	}
+	snprintf(path, sizeof(path), HOT_FILE_FORMAT, index);
+	thread->op_target = 0;
+
+	fd = openat(targets[0].dirfd, path, O_WRONLY | (append ? O_APPEND : 0));
+	if (fd == -1) {
+		perror("open");
+		return -1;
+	}
+
+	start = monotonic_nsecs();
+	if (hot_file_lock(fd, offset, lock_len, true) == -1) {
+		perror("lock");
+		if (close(fd) == -1)
+			perror("close");
+		return -1;
+	}
+	locked = monotonic_nsecs();
+
+	if (!append && lseek(fd, offset, SEEK_SET) == -1) {
+		perror("lseek");
+		ret = -1;
+	} else {
+		ret = write_to_file(thread, fd, -1, offset, size);
+	}
+	if (hot_file_lock(fd, offset, lock_len, false) == -1)
+		perror("unlock");
+	if (close(fd) == -1)
+		perror("close");
+	if (ret == -1)
+		return -1;
+
+	if (hot_lock != HOT_LOCK_NONE)
+		histogram_record(&thread->results.lock_wait, locked - start);
+	histogram_record(&thread->results.hot_io_latency,
+			 monotonic_nsecs() - locked);
+	if (append)
+		thread->results.hot_appends++;
+	else
+		thread->results.hot_updates++;
+	thread->results.bytes_written += ret;
+	histogram_record(&thread->results.write_sizes, ret);
+	thread->results.write_operations++;
+	return 0;
+}
+
+static int do_write(struct benchmark_thread *thread)
+{
+	char path[NAME_MAX];
+	struct benchmark_file file;
+	int dirfd, fd;
+	off_t offset = 0;
 	size_t size;
-	int ret;
+	ssize_t ret;
 
-	pthread_rwlock_rdlock(&files_lock);
-	if (pick_file(thread, path, NULL) == -1) {
-		pthread_rwlock_unlock(&files_lock);
-		return;
+	if (hot_files && prng_bool(&thread->prng, hot_file_ratio))
+		return do_hot_write(thread);
+
+	files_rdlock(thread->files);
+	dirfd = pick_file(thread, path, &file, NULL);
+	if (dirfd == -1) {
+		files_unlock(thread->files);
+		return -1;
 	}
 
-	fd = open(path, O_WRONLY | O_APPEND);
-	pthread_rwlock_unlock(&files_lock);
+	fd = openat(dirfd, path, O_WRONLY | O_APPEND);
+	files_unlock(thread->files);
 	if (fd == -1) {
 		perror("open");
-		return;
+		return -1;
+	}
+
+	if (verify) {
+		offset = lseek(fd, 0, SEEK_END);
+		if (offset == -1) {
+			perror("lseek");
+			if (close(fd) == -1)
+				perror("close");
+			return -1;
+		}
 	}
 
-	size = prng_range(&thread->prng, min_write_size, max_write_size + 1);
-	ret = write_to_file(thread, fd, size);
+	size = distribution_sample(&write_size_distribution, &thread->prng);
+	ret = write_to_file(thread, fd, file.id, offset, size);
 	if (close(fd) == -1)
 		perror("close");
 	if (ret == -1)
-		return;
+		return -1;
 
-	thread->results.bytes_written += size;
+	thread->results.bytes_written += ret;
+	histogram_record(&thread->results.write_sizes, ret);
 	thread->results.write_operations++;
+	return 0;
 }
 
-static void do_create(struct benchmark_thread *thread)
+static int do_create(struct benchmark_thread *thread)
 {
 	if (create_file(thread) == -1)
-		return;
+		return -1;
 
 	thread->results.create_operations++;
+	return 0;
 }
 
-static void do_delete(struct benchmark_thread *thread)
+static int do_delete(struct benchmark_thread *thread)
 {
+	struct file_table *table = thread->files;
 	char path[NAME_MAX];
 	uint32_t index;
+	int dirfd;
 
-	pthread_rwlock_wrlock(&files_lock);
-	if (pick_file(thread, path, &index) == -1) {
-		pthread_rwlock_unlock(&files_lock);
-		return;
+	files_wrlock(table);
+	dirfd = pick_file(thread, path, NULL, &index);
+	if (dirfd == -1) {
+		files_unlock(table);
+		return -1;
 	}
 
-	files_size--;
-	memmove(files_array + index, files_array + index + 1,
-		(files_size - index) * sizeof(files_array[0]));
-	pthread_rwlock_unlock(&files_lock);
+	table->size--;
+	memmove(table->files + index, table->files + index + 1,
+		(table->size - index) * sizeof(table->files[0]));
+	files_unlock(table);
 
-	if (unlink(path) == -1)
+	if (unlinkat(dirfd, path, 0) == -1) {
 		perror("unlink");
-	else
-		thread->results.delete_operations++;
+		return -1;
+	}
+
+	thread->results.delete_operations++;
+	return 0;
 }
 
-int init_benchmark_files(uint32_t prng_seed)
+static int do_rename(struct benchmark_thread *thread)
 {
-	struct benchmark_thread dummy_thread;
-	int ret;
+	char old_path[NAME_MAX], new_path[NAME_MAX];
+	struct benchmark_file file;
+	uint32_t index;
+	int dirfd;
 
-	prng_init(&dummy_thread.prng, prng_seed);
-	dummy_thread.buffer = malloc(block_size);
-	if (!dummy_thread.buffer) {
-		perror("malloc");
+	/*
+	 * Hold the lock for the rename itself so that nobody picks a name that
+	 * doesn't exist yet or anymore.
+	 */
+	files_wrlock(thread->files);
+	dirfd = pick_file(thread, old_path, &file, &index);
+	if (dirfd == -1) {
+		files_unlock(thread->files);
 		return -1;
 	}
 
-	for (long i = 0; i < initial_files; i++) {
-		ret = create_file(&dummy_thread);
-		if (ret)
-			return -1;
+	if (!maildir) {
+		file.name = next_name(thread->files);
+	} else if (file.location == FILE_NEW) {
+		/* The message has been seen by a client. */
+		file.location = FILE_CUR;
+		file.flags = MAILDIR_FLAG_SEEN;
+	} else {
+		file.flags ^= 1 << prng_range(&thread->prng, 0,
+					      MAILDIR_NUM_FLAGS);
 	}
+	format_path(new_path, &file);
 
-	free(dummy_thread.buffer);
-	return 0;
-}
+	if (renameat(dirfd, old_path, dirfd, new_path) == -1) {
+		perror("rename");
+		files_unlock(thread->files);
+		return -1;
+	}
+
+	thread->files->files[index] = file;
+	files_unlock(thread->files);
+	thread->results.rename_operations++;
+	return 0;
+}
+
+static int do_link(struct benchmark_thread *thread)
+{
+	char old_path[NAME_MAX], new_path[NAME_MAX];
+	struct benchmark_file file;
+	int dirfd, ret;
+
+	files_rdlock(thread->files);
+	dirfd = pick_file(thread, old_path, &file, NULL);
+	if (dirfd == -1) {
+		files_unlock(thread->files);
+		return -1;
+	}
+
+	file.name = next_name(thread->files);
+	format_path(new_path, &file);
+	ret = linkat(dirfd, old_path, dirfd, new_path, 0);
+	files_unlock(thread->files);
+	if (ret == -1) {
+		perror("link");
+		return -1;
+	}
+
+	if (add_file(thread->files, &file) == -1)
+		return -1;
+	thread->results.link_operations++;
+	return 0;
+}
+
+/*
+ * Copy a file's data from its current position with copy_file_range(), or by
+ * reading and writing it where that isn't supported. Returns the number of
+ * bytes copied or -1 on error.
+ */
+static ssize_t copy_data(struct benchmark_thread *thread, int in, int out)
+{
+	ssize_t total = 0, ret;
+
+#ifdef __linux__
+	while (!is_unsupported(&copy_file_range_unsupported)) {
+		ret = copy_file_range(in, NULL, out, NULL, SSIZE_MAX, 0);
+		if (ret == 0)
+			return total;
+		if (ret > 0) {
+			total += ret;
+			continue;
+		}
+		if (errno == EINTR)
+			continue;
+		if (errno == ENOSYS || errno == EOPNOTSUPP) {
+			set_unsupported(&copy_file_range_unsupported,
+					"copy_file_range is not supported; copying by reading and writing");
+			break;
+		}
+		/* Older kernels can't copy between some files. */
+		if (errno == EXDEV || errno == EINVAL)
+			break;
+		perror("copy_file_range");
+		return -1;
+	}
+#endif
+
+	/* Both file positions are where the copy left off. */
+	thread->results.copy_fallbacks++;
+	while ((ret = read_full(thread, in, thread->buffer, io_size())) > 0) {
+		if (write_full(thread, out, thread->buffer, ret) == -1) {
+			perror("write");
+			return -1;
+		}
+		total += ret;
+	}
+	if (ret == -1) {
+		perror("read");
+		return -1;
+	}
+	return total;
+}
+
+/*
+ * Share a file's data with FICLONE, or copy it where that isn't supported.
+ * Returns the number of bytes cloned or -1 on error.
+ */
+static ssize_t clone_data(struct benchmark_thread *thread, int in, int out)
+{
+#ifdef FICLONE
+	struct stat st;
+
+	if (!is_unsupported(&ficlone_unsupported)) {
+		if (fstat(in, &st) == -1) {
+			perror("fstat");
+			return -1;
+		}
+		if (ioctl(out, FICLONE, in) == 0)
+			return st.st_size;
+		if (errno == EOPNOTSUPP || errno == ENOTTY) {
+			set_unsupported(&ficlone_unsupported,
+					"FICLONE is not supported; copying instead of cloning");
+		} else if (errno != EXDEV && errno != EINVAL) {
+			perror("FICLONE");
+			return -1;
+		}
+	}
+#endif
+	thread->results.clone_fallbacks++;
+	return copy_data(thread, in, out);
+}
+
+/*
+ * With verify, a file copied while another thread was appending to it can end
+ * in part of a record, which later reads would report as a mismatch, so cut
+ * the copy back to whole records. A bad record header is left for reads to
+ * report. Returns the new length of the copy or -1 on error.
+ */
+static ssize_t trim_partial_record(struct benchmark_thread *thread, int fd,
+				   size_t length)
+{
+	size_t capacity = io_buffer_size();
+	struct verify_header header;
+	size_t offset = 0;
+
+	while (length - offset >= VERIFY_HEADER_SIZE) {
+		size_t count = length - offset, consumed = 0;
+		ssize_t ret;
+
+		if (count > capacity)
+			count = capacity;
+		ret = pread(fd, thread->buffer, count, offset);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("pread");
+			return -1;
+		}
+
+		while (ret - consumed >= VERIFY_HEADER_SIZE) {
+			memcpy(&header, thread->buffer + consumed,
+			       VERIFY_HEADER_SIZE);
+			if (header.magic != VERIFY_MAGIC ||
+			    header.length < VERIFY_HEADER_SIZE ||
+			    header.length > block_size)
+				return length;
+			if (ret - consumed < header.length)
+				break;
+			consumed += header.length;
+		}
+		if (consumed == 0)
+			break;
+		offset += consumed;
+	}
+
+	if (offset < length && ftruncate(fd, offset) == -1) {
+		perror("ftruncate");
+		return -1;
+	}
+	return offset;
+}
+
+/* Copy or clone a file to a new one next to it. */
+static int copy_file(struct benchmark_thread *thread, bool clone)
+{
+	char path[NAME_MAX];
+	struct benchmark_file file;
+	int dirfd, in, out;
+	ssize_t ret, size;
+
+	files_rdlock(thread->files);
+	dirfd = pick_file(thread, path, &file, NULL);
+	if (dirfd == -1) {
+		files_unlock(thread->files);
+		return -1;
+	}
+
+	in = openat(dirfd, path, O_RDONLY);
+	files_unlock(thread->files);
+	if (in == -1) {
+		perror("open");
+		return -1;
+	}
+
+	/* Like a link, the copy keeps the id since it has the same contents. */
+	file.name = next_name(thread->files);
+	file.location = maildir ? FILE_NEW : FILE_TOP;
+	file.flags = 0;
+	format_path(path, &file);
+	out = openat(dirfd, path, O_CREAT | O_EXCL | (verify ? O_RDWR : O_WRONLY),
+		     S_IRUSR | S_IWUSR);
+	if (out == -1) {
+		perror("open");
+		if (close(in) == -1)
+			perror("close");
+		return -1;
+	}
+
+	ret = clone ? clone_data(thread, in, out) : copy_data(thread, in, out);
+	size = ret;
+	if (ret > 0 && verify)
+		size = trim_partial_record(thread, out, ret);
+	if (close(out) == -1)
+		perror("close");
+	if (close(in) == -1)
+		perror("close");
+	if (size == -1) {
+		if (unlinkat(dirfd, path, 0) == -1)
+			perror("unlinkat");
+		return -1;
+	}
+
+	file.size = size;
+	if (add_file(thread->files, &file) == -1)
+		return -1;
+	if (clone) {
+		thread->results.bytes_cloned += ret;
+		thread->results.clone_operations++;
+	} else {
+		thread->results.bytes_copied += ret;
+		thread->results.copy_operations++;
+	}
+	return 0;
+}
+
+static int do_copy(struct benchmark_thread *thread)
+{
+	return copy_file(thread, false);
+}
+
+static int do_clone(struct benchmark_thread *thread)
+{
+	return copy_file(thread, true);
+}
+
+static int do_stat(struct benchmark_thread *thread)
+{
+	char path[NAME_MAX];
+	struct stat st;
+	int dirfd, ret;
+
+	files_rdlock(thread->files);
+	dirfd = pick_file(thread, path, NULL, NULL);
+	if (dirfd == -1) {
+		files_unlock(thread->files);
+		return -1;
+	}
+
+	ret = fstatat(dirfd, path, &st, 0);
+	files_unlock(thread->files);
+	if (ret == -1) {
+		perror("stat");
+		return -1;
+	}
+
+	thread->results.stat_operations++;
+	return 0;
+}
+
+static int scan_dir(struct benchmark_thread *thread, int dirfd,
+		    const char *path)
+{
+	DIR *dir;
+	int fd, ret = 0;
+
+	fd = openat(dirfd, path, O_RDONLY | O_DIRECTORY);
+	if (fd == -1) {
+		perror("openat");
+		return -1;
+	}
+	dir = fdopendir(fd);
+	if (!dir) {
+		perror("fdopendir");
+		close(fd);
+		return -1;
+	}
+
+	for (;;) {
+		errno = 0;
+		if (!readdir(dir)) {
+			if (errno) {
+				perror("readdir");
+				ret = -1;
+			}
+			break;
+		}
+		thread->results.readdir_entries++;
+	}
+
+	if (closedir(dir) == -1)
+		perror("closedir");
+	return ret;
+}
+
+static int do_readdir(struct benchmark_thread *thread)
+{
+	int dirfd;
+
+	if (num_targets == 1)
+		thread->op_target = 0;
+	else if (target_policy == TARGET_PER_THREAD)
+		thread->op_target = thread->target;
+	else
+		thread->op_target = prng_range(&thread->prng, 0, num_targets);
+	dirfd = table_dirfd(thread->files, thread->op_target);
+
+	/* A maildir client checks both new/ and cur/. */
+	if (maildir) {
+		if (scan_dir(thread, dirfd, "new") == -1 ||
+		    scan_dir(thread, dirfd, "cur") == -1)
+			return -1;
+	} else {
+		if (scan_dir(thread, dirfd, ".") == -1)
+			return -1;
+	}
+
+	thread->results.readdir_operations++;
+	return 0;
+}
+
+/* If the workload modifies the files, a manifest doesn't survive the run. */
+bool workload_modifies_files(void)
+{
+	if (copy_ratio > 0.0 || clone_ratio > 0.0)
+		return true;
+	if (metadata_ratio > 0.0 && namespace_lookup_ratio > 0.0)
+		return true;
+	if (metadata_ratio < 1.0 &&
+	    (io_dir_ratio < 1.0 || read_write_ratio < 1.0))
+		return true;
+	return false;
+}
+
+/* Everything which affects the initial set of files. */
+static void write_manifest_header(FILE *file, uint32_t prng_seed)
+{
+	char dist[PARAM_VALUE_MAX];
+
+	fprintf(file, "omark-manifest 3\n");
+	fprintf(file, "seed %" PRIu32 "\n", prng_seed);
+	fprintf(file, "block-size %zu\n", block_size);
+	fprintf(file, "block-aligned %s\n", block_aligned ? "true" : "false");
+	fprintf(file, "initial-files %lu\n", initial_files);
+	fprintf(file, "min-file-size %zu\n", min_file_size);
+	fprintf(file, "max-file-size %zu\n", max_file_size);
+	describe_distribution(&file_size_distribution, dist, sizeof(dist));
+	fprintf(file, "file-size-distribution %s", dist);
+	if (file_size_distribution.type == DIST_EMPIRICAL)
+		fprintf(file, " %08" PRIx32, file_size_distribution.hash);
+	fprintf(file, "\n");
+	fprintf(file, "verify %s\n", verify ? "true" : "false");
+	fprintf(file, "maildir %s\n", maildir ? "true" : "false");
+	if (preallocate)
+		fprintf(file, "preallocate true\n");
+	fprintf(file, "targets %u\n", num_targets);
+	for (unsigned int t = 0; t < num_targets; t++)
+		fprintf(file, "target %s\n", targets[t].path);
+	if (num_targets > 1) {
+		fprintf(file, "target-policy %s\n",
+			target_policy_names[target_policy]);
+	}
+	if (partitions) {
+		fprintf(file, "namespace %s\n",
+			namespace_mode_names[namespace_mode]);
+		fprintf(file, "partitions %d\n", num_partitions);
+	}
+}
+
+/* Open a file in the first target, which holds the manifest. */
+static FILE *open_manifest(const char *path, int flags, const char *mode)
+{
+	FILE *file;
+	int fd;
+
+	fd = openat(targets[0].dirfd, path, flags, S_IRUSR | S_IWUSR);
+	if (fd == -1) {
+		if (errno != ENOENT)
+			perror("openat");
+		return NULL;
+	}
+	file = fdopen(fd, mode);
+	if (!file) {
+		perror("fdopen");
+		close(fd);
+	}
+	return file;
+}
+
+static int write_manifest(uint32_t prng_seed)
+{
+	FILE *file;
+
+	file = open_manifest(MANIFEST_TMP_PATH, O_WRONLY | O_CREAT | O_TRUNC,
+			     "w");
+	if (!file)
+		return -1;
+
+	write_manifest_header(file, prng_seed);
+	/* The files of each partition, or of the shared namespace. */
+	for (int t = 0; t < num_file_tables(); t++) {
+		const struct file_table *table = file_table(t);
+
+		fprintf(file, "next-name %ld\n", table->next_name);
+		fprintf(file, "next-generation %" PRIu64 "\n",
+			table->next_generation);
+		fprintf(file, "files %zu\n", table->size);
+		for (size_t i = 0; i < table->size; i++) {
+			const struct benchmark_file *f = &table->files[i];
+
+			fprintf(file, "%ld %ld %u %u %u %zu\n", f->name, f->id,
+				f->target, f->location, f->flags, f->size);
+		}
+	}
+
+	if (fflush(file) == EOF || fsync(fileno(file)) == -1) {
+		perror("fsync");
+		fclose(file);
+		return -1;
+	}
+	if (fclose(file) == EOF) {
+		perror("fclose");
+		return -1;
+	}
+	if (renameat(targets[0].dirfd, MANIFEST_TMP_PATH, targets[0].dirfd,
+		     MANIFEST_PATH) == -1) {
+		perror("rename");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * Check a sample of the files of a table loaded from the manifest against the
+ * filesystem.
+ */
+static int check_manifest_files(const struct file_table *table,
+				struct prng *prng)
+{
+	size_t samples;
+
+	samples = (table->size < MANIFEST_SAMPLES ? table->size :
+		   MANIFEST_SAMPLES);
+	for (size_t i = 0; i < samples; i++) {
+		const struct benchmark_file *file;
+		char path[NAME_MAX];
+		struct stat st;
+
+		if (samples == table->size)
+			file = &table->files[i];
+		else
+			file = &table->files[prng_range(prng, 0, table->size)];
+		format_path(path, file);
+		if (fstatat(table_dirfd(table, file->target), path, &st,
+			    0) == -1) {
+			fprintf(stderr, "Manifest file %s: %s\n", path,
+				strerror(errno));
+			return -1;
+		}
+		if (!S_ISREG(st.st_mode) || st.st_size != file->size) {
+			fprintf(stderr, "Manifest file %s has changed\n", path);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Load the file table from the manifest if it was written for the same
+ * parameters and seed and the files are still there.
+ */
+static int load_manifest(uint32_t prng_seed)
+{
+	FILE *file, *expected;
+	char *header = NULL, *line = NULL, *expected_line;
+	size_t header_size, n = 0;
+	struct prng prng;
+	uint64_t next_generation;
+	long next_name;
+	size_t num_files;
+	int ret = -1;
+
+	file = open_manifest(MANIFEST_PATH, O_RDONLY, "r");
+	if (!file)
+		return -1;
+
+	expected = open_memstream(&header, &header_size);
+	if (!expected) {
+		perror("open_memstream");
+		goto out;
+	}
+	write_manifest_header(expected, prng_seed);
+	fclose(expected);
+
+	expected_line = header;
+	while (*expected_line) {
+		char *next = strchr(expected_line, '\n') + 1;
+
+		if (getline(&line, &n, file) == -1 ||
+		    strncmp(line, expected_line, next - expected_line) != 0) {
+			fprintf(stderr, "Manifest does not match parameters\n");
+			goto out;
+		}
+		expected_line = next;
+	}
+
+	for (int t = 0; t < num_file_tables(); t++) {
+		struct file_table *table = file_table(t);
+
+		if (fscanf(file, "next-name %ld\n", &next_name) != 1 ||
+		    fscanf(file, "next-generation %" SCNu64 "\n",
+			   &next_generation) != 1 ||
+		    fscanf(file, "files %zu\n", &num_files) != 1)
+			goto invalid;
+
+		table->files = malloc(sizeof(table->files[0]) *
+				      (num_files ? num_files : 1));
+		if (!table->files) {
+			perror("malloc");
+			goto out;
+		}
+		table->capacity = num_files;
+		for (table->size = 0; table->size < num_files; table->size++) {
+			struct benchmark_file *f = &table->files[table->size];
+			unsigned int target, location, flags;
+
+			if (fscanf(file, "%ld %ld %u %u %u %zu\n", &f->name,
+				   &f->id, &target, &location, &flags,
+				   &f->size) != 6 ||
+			    target >= num_targets || location > FILE_CUR)
+				goto invalid;
+			f->target = target;
+			f->location = location;
+			f->flags = flags;
+		}
+		table->next_name = next_name;
+		table->next_generation = next_generation;
+	}
+
+	prng_init(&prng, prng_seed);
+	for (int t = 0; t < num_file_tables(); t++) {
+		ret = check_manifest_files(file_table(t), &prng);
+		if (ret)
+			break;
+	}
+	goto out;
+
+invalid:
+	fprintf(stderr, "Manifest is invalid\n");
+out:
+	for (int t = 0; ret && t < num_file_tables(); t++) {
+		struct file_table *table = file_table(t);
+
+		free(table->files);
+		table->files = NULL;
+		table->size = table->capacity = 0;
+		table->next_name = 0;
+		table->next_generation = 0;
+	}
+	free(line);
+	free(header);
+	fclose(file);
+	return ret;
+}
+
+int add_target(const char *path)
+{
+	struct target *new_targets;
+	int dirfd;
+
+	/* Files record their target in an unsigned short. */
+	if (num_targets >= 65536) {
+		fprintf(stderr, "Too many targets\n");
+		return -1;
+	}
+
+	dirfd = open(path, O_RDONLY | O_DIRECTORY);
+	if (dirfd == -1) {
+		perror(path);
+		return -1;
+	}
+	new_targets = realloc(targets, sizeof(targets[0]) * (num_targets + 1));
+	if (!new_targets) {
+		perror("realloc");
+		close(dirfd);
+		return -1;
+	}
+	targets = new_targets;
+	targets[num_targets].path = strdup(path);
+	if (!targets[num_targets].path) {
+		perror("strdup");
+		close(dirfd);
+		return -1;
+	}
+	targets[num_targets++].dirfd = dirfd;
+	return 0;
+}
+
+static int make_maildir_dirs(int dirfd)
+{
+	for (int i = 0; i < 3; i++) {
+		if (mkdirat(dirfd, maildir_dirs[i], S_IRWXU) == -1 &&
+		    errno != EEXIST) {
+			perror("mkdirat");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Give each thread a file table of its own with a private subdirectory in
+ * every target, and its share of max_operations.
+ */
+static int init_partitions(struct benchmark_thread *threads, int num_threads)
+{
+	char name[NAME_MAX];
+
+	partitions = calloc(num_threads, sizeof(partitions[0]));
+	if (!partitions) {
+		perror("calloc");
+		return -1;
+	}
+	num_partitions = num_threads;
+
+	for (int p = 0; p < num_threads; p++) {
+		struct file_table *table = &partitions[p];
+
+		table->max_operations = (max_operations / num_threads +
+					 ((unsigned long)p <
+					  max_operations % num_threads));
+		table->dirfds = malloc(sizeof(table->dirfds[0]) * num_targets);
+		if (!table->dirfds) {
+			perror("malloc");
+			return -1;
+		}
+		for (unsigned int t = 0; t < num_targets; t++)
+			table->dirfds[t] = -1;
+
+		snprintf(name, sizeof(name), PARTITION_FORMAT, p);
+		for (unsigned int t = 0; t < num_targets; t++) {
+			if (mkdirat(targets[t].dirfd, name, S_IRWXU) == -1 &&
+			    errno != EEXIST) {
+				perror("mkdirat");
+				return -1;
+			}
+			table->dirfds[t] = openat(targets[t].dirfd, name,
+						  O_RDONLY | O_DIRECTORY);
+			if (table->dirfds[t] == -1) {
+				perror("openat");
+				return -1;
+			}
+			if (maildir &&
+			    make_maildir_dirs(table->dirfds[t]) == -1)
+				return -1;
+		}
+		threads[p].files = table;
+	}
+	return 0;
+}
+
+/*
+ * Create the hot files, with a PRNG of their own so that the other initial
+ * files are the same with or without them. They are recreated for every run
+ * rather than recorded in the manifest.
+ */
+static int create_hot_files(uint32_t prng_seed)
+{
+	struct benchmark_thread dummy_thread = {};
+	char path[NAME_MAX];
+	ssize_t ret = 0;
+	int fd;
+
+	if (hot_files == 0)
+		return 0;
+
+	hot_file_sizes = calloc(hot_files, sizeof(hot_file_sizes[0]));
+	dummy_thread.buffer = malloc(io_buffer_size());
+	if (!hot_file_sizes || !dummy_thread.buffer) {
+		perror("malloc");
+		free(dummy_thread.buffer);
+		return -1;
+	}
+	prng_init(&dummy_thread.prng, ~prng_seed);
+	dummy_thread.files = &shared_files;
+
+	for (unsigned long i = 0; i < hot_files && ret != -1; i++) {
+		size_t size;
+
+		snprintf(path, sizeof(path), HOT_FILE_FORMAT, i);
+		fd = openat(targets[0].dirfd, path,
+			    O_CREAT | O_WRONLY | O_TRUNC | O_APPEND,
+			    S_IRUSR | S_IWUSR);
+		if (fd == -1) {
+			perror("open");
+			ret = -1;
+			break;
+		}
+		size = distribution_sample(&file_size_distribution,
+					   &dummy_thread.prng);
+		ret = write_to_file(&dummy_thread, fd, -1, 0, size);
+		if (close(fd) == -1)
+			perror("close");
+		if (ret != -1)
+			hot_file_sizes[i] = ret;
+	}
+
+	free(dummy_thread.buffer);
+	return ret == -1 ? -1 : 0;
+}
+
+static size_t total_files(void)
+{
+	size_t total = 0;
+
+	for (int t = 0; t < num_file_tables(); t++)
+		total += file_table(t)->size;
+	return total;
+}
+
+int init_benchmark_files(struct benchmark_thread *threads, int num_threads,
+			 uint32_t prng_seed, bool reuse)
+{
+	struct benchmark_thread dummy_thread = {};
+	int ret;
+
+	if (namespace_mode == NAMESPACE_PARTITIONED) {
+		if (init_partitions(threads, num_threads) == -1)
+			return -1;
+	} else {
+		for (int i = 0; i < num_threads; i++)
+			threads[i].files = &shared_files;
+		for (unsigned int t = 0; maildir && t < num_targets; t++) {
+			if (make_maildir_dirs(targets[t].dirfd) == -1)
+				return -1;
+		}
+	}
+
+	if (reuse && load_manifest(prng_seed) == 0) {
+		fprintf(stderr, "Reusing %zu benchmark files from manifest\n",
+			total_files());
+		/* The files won't match the manifest once the benchmark runs. */
+		if (workload_modifies_files() &&
+		    unlinkat(targets[0].dirfd, MANIFEST_PATH, 0) == -1) {
+			perror("unlinkat");
+			return -1;
+		}
+		goto out;
+	}
+
+	if (unlinkat(targets[0].dirfd, MANIFEST_PATH, 0) == -1 &&
+	    errno != ENOENT) {
+		perror("unlinkat");
+		return -1;
+	}
+
+	fprintf(stderr, "Creating initial benchmark files...\n");
+	prng_init(&dummy_thread.prng, prng_seed);
+	dummy_thread.buffer = malloc(io_buffer_size());
+	if (!dummy_thread.buffer) {
+		perror("malloc");
+		return -1;
+	}
+
+	/*
+	 * The same files as in the shared namespace are dealt out to the
+	 * partitions in turn.
+	 */
+	for (long i = 0; i < initial_files; i++) {
+		int table = i % num_file_tables();
+
+		dummy_thread.files = file_table(table);
+		/* Per-thread placement spreads the initial files evenly. */
+		dummy_thread.target = (partitions ? table : i) % num_targets;
+		ret = create_file(&dummy_thread);
+		if (ret)
+			return -1;
+	}
+
+	free(dummy_thread.buffer);
+
+	/* Don't write a manifest which the benchmark would invalidate. */
+	if (reuse && !workload_modifies_files() &&
+	    write_manifest(prng_seed) == -1)
+		return -1;
+
+out:
+	for (int t = 0; t < num_file_tables(); t++) {
+		struct file_table *table = file_table(t);
+
+		for (size_t i = 0; i < table->size; i++)
+			histogram_record(&initial_file_sizes,
+					 table->files[i].size);
+	}
+
+	return create_hot_files(prng_seed);
+}
 
 void uninit_benchmark(void)
 {
-	free(files_array);
+	for (int p = 0; p < num_partitions; p++) {
+		struct file_table *table = &partitions[p];
+
+		free(table->files);
+		for (unsigned int t = 0; table->dirfds && t < num_targets;
+		     t++) {
+			if (table->dirfds[t] != -1)
+				close(table->dirfds[t]);
+		}
+		free(table->dirfds);
+	}
+	free(partitions);
+	partitions = NULL;
+	num_partitions = 0;
+	free(hot_file_sizes);
+	hot_file_sizes = NULL;
+	memset(&initial_file_sizes, 0, sizeof(initial_file_sizes));
+
+	free(shared_files.files);
+	shared_files.files = NULL;
+	shared_files.size = shared_files.capacity = 0;
+	shared_files.next_name = 0;
+	shared_files.next_generation = 0;
+	shared_files.next_target = 0;
+	cleanup_cursor = 0;
+}
+
+void reset_benchmark(void)
+{
+	num_operations = 0;
+}
+
+void add_initial_file_sizes(struct benchmark_results *results)
+{
+	histogram_merge(&results->initial_file_sizes, &initial_file_sizes);
 }
 
 static inline void timespec_subtract(struct timespec *restrict result,
@@ -291,16 +1907,147 @@ static inline void timespec_subtract(struct timespec *restrict result,
 	}
 }
 
+static int (*const operations[NUM_OPS])(struct benchmark_thread *) = {
+	[OP_READ] = do_read,
+	[OP_WRITE] = do_write,
+	[OP_CREATE] = do_create,
+	[OP_DELETE] = do_delete,
+	[OP_RENAME] = do_rename,
+	[OP_LINK] = do_link,
+	[OP_STAT] = do_stat,
+	[OP_READDIR] = do_readdir,
+	[OP_COPY] = do_copy,
+	[OP_CLONE] = do_clone,
+};
+
+static enum operation pick_operation(struct benchmark_thread *thread)
+{
+	if (copy_ratio > 0.0 && prng_bool(&thread->prng, copy_ratio))
+		return OP_COPY;
+	if (clone_ratio > 0.0 &&
+	    prng_bool(&thread->prng, clone_ratio / (1.0 - copy_ratio)))
+		return OP_CLONE;
+
+	if (metadata_ratio > 0.0 && prng_bool(&thread->prng, metadata_ratio)) {
+		if (namespace_lookup_ratio > 0.0 &&
+		    prng_bool(&thread->prng, namespace_lookup_ratio)) {
+			if (prng_bool(&thread->prng, rename_link_ratio))
+				return OP_RENAME;
+			else
+				return OP_LINK;
+		} else {
+			if (prng_bool(&thread->prng, stat_readdir_ratio))
+				return OP_STAT;
+			else
+				return OP_READDIR;
+		}
+	} else if (prng_bool(&thread->prng, io_dir_ratio)) {
+		if (prng_bool(&thread->prng, read_write_ratio))
+			return OP_READ;
+		else
+			return OP_WRITE;
+	} else {
+		if (prng_bool(&thread->prng, create_delete_ratio))
+			return OP_CREATE;
+		else
+			return OP_DELETE;
+	}
+}
+
+static unsigned long *operation_counter(struct benchmark_results *results,
+					enum operation op)
+{
+	switch (op) {
+	case OP_READ:
+		return &results->read_operations;
+	case OP_WRITE:
+		return &results->write_operations;
+	case OP_CREATE:
+		return &results->create_operations;
+	case OP_DELETE:
+		return &results->delete_operations;
+	case OP_RENAME:
+		return &results->rename_operations;
+	case OP_LINK:
+		return &results->link_operations;
+	case OP_STAT:
+		return &results->stat_operations;
+	case OP_READDIR:
+		return &results->readdir_operations;
+	case OP_COPY:
+		return &results->copy_operations;
+	case OP_CLONE:
+	default:
+		return &results->clone_operations;
+	}
+}
+
+/* Totals which an operation adds to, saved before it runs. */
+struct op_counters {
+	size_t bytes_read;
+	size_t bytes_written;
+	size_t bytes_copied;
+	size_t bytes_cloned;
+	unsigned long readdir_entries;
+};
+
+static void save_counters(struct op_counters *counters,
+			  const struct benchmark_results *results)
+{
+	counters->bytes_read = results->bytes_read;
+	counters->bytes_written = results->bytes_written;
+	counters->bytes_copied = results->bytes_copied;
+	counters->bytes_cloned = results->bytes_cloned;
+	counters->readdir_entries = results->readdir_entries;
+}
+
+/* Bytes read, written, copied, or cloned by an operation. */
+static size_t bytes_moved(const struct benchmark_results *results,
+			  const struct op_counters *before)
+{
+	return (results->bytes_read - before->bytes_read +
+		results->bytes_written - before->bytes_written +
+		results->bytes_copied - before->bytes_copied +
+		results->bytes_cloned - before->bytes_cloned);
+}
+
+/*
+ * Charge a successful operation to the target it was on, along with what it
+ * added to the thread's totals.
+ */
+static void record_target(struct benchmark_thread *thread, enum operation op,
+			  uint64_t latency, const struct op_counters *before)
+{
+	const struct benchmark_results *totals = &thread->results;
+	struct benchmark_results *results;
+
+	results = &thread->target_results[thread->op_target];
+	(*operation_counter(results, op))++;
+	results->bytes_read += totals->bytes_read - before->bytes_read;
+	results->bytes_written += totals->bytes_written - before->bytes_written;
+	results->bytes_copied += totals->bytes_copied - before->bytes_copied;
+	results->bytes_cloned += totals->bytes_cloned - before->bytes_cloned;
+	results->readdir_entries += (totals->readdir_entries -
+				     before->readdir_entries);
+	histogram_record(&results->latency[op], latency);
+}
+
 void *run_benchmark(void *arg)
 {
 	struct benchmark_thread *thread = arg;
 	struct timespec start_time, end_time, elapsed_time;
+	uint64_t start_nsecs, op_start, op_end, last_publish;
+	unsigned long ops = 0;
+	struct op_counters before;
+	enum operation op;
+	int ret;
 
 	prng_init(&thread->prng, thread->prng_seed);
 
 	pthread_barrier_wait(&barrier);
 
 	clock_gettime(CLOCK_MONOTONIC, &start_time);
+	start_nsecs = last_publish = monotonic_nsecs();
 
 	for (;;) {
 		if (time_limit) {
@@ -310,28 +2057,173 @@ void *run_benchmark(void *arg)
 				break;
 		}
 
-		if (max_operations) {
-			long ops = __atomic_fetch_add(&num_operations, 1,
-						      __ATOMIC_SEQ_CST);
-			if (ops >= max_operations)
+		if (max_operations && !thread->files->shared) {
+			/* A partition runs its share without coordinating. */
+			if (ops++ >= thread->files->max_operations)
+				break;
+		} else if (max_operations) {
+			long done = __atomic_fetch_add(&num_operations, 1,
+						       __ATOMIC_SEQ_CST);
+			if (done >= max_operations)
 				break;
 		}
 
-		if (prng_bool(&thread->prng, io_dir_ratio)) {
-			if (prng_bool(&thread->prng, read_write_ratio))
-				do_read(thread);
-			else
-				do_write(thread);
-		} else {
-			if (prng_bool(&thread->prng, create_delete_ratio))
-				do_create(thread);
-			else
-				do_delete(thread);
+		op = pick_operation(thread);
+		thread->op_file = -1;
+		save_counters(&before, &thread->results);
+		op_start = monotonic_nsecs();
+		ret = operations[op](thread);
+		op_end = monotonic_nsecs();
+		if (ret == 0) {
+			histogram_record(&thread->results.latency[op],
+					 op_end - op_start);
+			if (thread->target_results) {
+				record_target(thread, op, op_end - op_start,
+					      &before);
+			}
+			if (thread->slow_log &&
+			    op_end - op_start >= slow_threshold_nsecs) {
+				struct slow_op slow = {
+					.start_nsecs = op_start,
+					.latency_nsecs = op_end - op_start,
+					.file_id = thread->op_file,
+					.size = bytes_moved(&thread->results,
+							    &before),
+					.op = op,
+					.target = thread->op_target,
+				};
+
+				slow_log_record(thread->slow_log, &slow);
+			}
+		}
+
+		if (thread->live && op_end - last_publish >= LIVE_INTERVAL_NSECS) {
+			live_publish(thread->live, &thread->results,
+				     op_end - start_nsecs);
+			last_publish = op_end;
 		}
 	}
 
 	clock_gettime(CLOCK_MONOTONIC, &end_time);
 	timespec_subtract(&thread->results.elapsed_time, &end_time, &start_time);
+	if (thread->live) {
+		live_publish(thread->live, &thread->results,
+			     monotonic_nsecs() - start_nsecs);
+	}
+
+	return NULL;
+}
+
+static void remove_dir(int dirfd, const char *path,
+		       struct cleanup_results *results)
+{
+	uint64_t op_start = monotonic_nsecs();
+
+	if (unlinkat(dirfd, path, AT_REMOVEDIR) == -1) {
+		perror("rmdir");
+		return;
+	}
+	histogram_record(&results->latency, monotonic_nsecs() - op_start);
+	results->rmdir_operations++;
+}
+
+/* Remove the files of a thread's partition and its directories. */
+static void cleanup_partition(const struct file_table *table,
+			      struct cleanup_results *results)
+{
+	char path[NAME_MAX];
+	uint64_t op_start;
+
+	for (size_t i = 0; i < table->size; i++) {
+		const struct benchmark_file *file = &table->files[i];
+
+		format_path(path, file);
+		op_start = monotonic_nsecs();
+		if (unlinkat(table->dirfds[file->target], path, 0) == -1) {
+			perror("unlinkat");
+			continue;
+		}
+		histogram_record(&results->latency,
+				 monotonic_nsecs() - op_start);
+		results->unlink_operations++;
+	}
+
+	snprintf(path, sizeof(path), PARTITION_FORMAT,
+		 (int)(table - partitions));
+	for (unsigned int t = 0; t < num_targets; t++) {
+		for (int i = 0; maildir && i < 3; i++)
+			remove_dir(table->dirfds[t], maildir_dirs[i], results);
+		remove_dir(targets[t].dirfd, path, results);
+	}
+}
+
+void *run_cleanup(void *arg)
+{
+	struct benchmark_thread *thread = arg;
+	struct cleanup_results *results = &thread->cleanup_results;
+	struct timespec start_time, end_time;
+	char path[NAME_MAX];
+	uint64_t op_start;
+	int ret;
+
+	pthread_barrier_wait(&barrier);
+
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+	if (partitions) {
+		cleanup_partition(thread->files, results);
+	} else {
+		for (;;) {
+			size_t index = __atomic_fetch_add(&cleanup_cursor, 1,
+							  __ATOMIC_RELAXED);
+			const struct benchmark_file *file;
+
+			if (index >= shared_files.size)
+				break;
+
+			file = &shared_files.files[index];
+			format_path(path, file);
+			op_start = monotonic_nsecs();
+			if (unlinkat(targets[file->target].dirfd, path,
+				     0) == -1) {
+				perror("unlinkat");
+				continue;
+			}
+			histogram_record(&results->latency,
+					 monotonic_nsecs() - op_start);
+			results->unlink_operations++;
+		}
+	}
+
+	/* The last thread to finish removes the directories. */
+	ret = pthread_barrier_wait(&barrier);
+	if (ret == PTHREAD_BARRIER_SERIAL_THREAD) {
+		if (unlinkat(targets[0].dirfd, MANIFEST_PATH, 0) == -1 &&
+		    errno != ENOENT)
+			perror("unlinkat");
+
+		for (unsigned long i = 0; i < hot_files; i++) {
+			snprintf(path, sizeof(path), HOT_FILE_FORMAT, i);
+			op_start = monotonic_nsecs();
+			if (unlinkat(targets[0].dirfd, path, 0) == -1) {
+				perror("unlinkat");
+				continue;
+			}
+			histogram_record(&results->latency,
+					 monotonic_nsecs() - op_start);
+			results->unlink_operations++;
+		}
+
+		for (unsigned int t = 0; maildir && !partitions &&
+		     t < num_targets; t++) {
+			for (int i = 0; i < 3; i++)
+				remove_dir(targets[t].dirfd, maildir_dirs[i],
+					   results);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end_time);
+	timespec_subtract(&results->elapsed_time, &end_time, &start_time);
 
 	return NULL;
 }
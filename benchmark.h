@@ -1,11 +1,45 @@
 #ifndef BENCHMARK_H
 #define BENCHMARK_H
 
+#include <stdbool.h>
 #include <time.h>
 #include <pthread.h>
 #include <unistd.h>
+#include "histogram.h"
 #include "prng.h"
 
+/*
+ * With verify enabled, every chunk written to a file is a self-describing
+ * record: this header followed by random payload. The checksum covers
+ * everything after the checksum field, including the rest of the header.
+ */
+struct verify_header {
+	uint32_t magic;
+	uint32_t crc;
+	uint32_t length;	/* Including the header. */
+	uint32_t reserved;
+	uint64_t file_id;
+	uint64_t offset;
+	uint64_t generation;
+};
+
+#define VERIFY_MAGIC UINT32_C(0x6f6d726b)
+#define VERIFY_HEADER_SIZE 40
+
+enum operation {
+	OP_READ,
+	OP_WRITE,
+	OP_CREATE,
+	OP_DELETE,
+	OP_RENAME,
+	OP_LINK,
+	OP_STAT,
+	OP_READDIR,
+	OP_COPY,
+	OP_CLONE,
+	NUM_OPS,
+};
+
 struct benchmark_results {
 	struct timespec elapsed_time;
 
@@ -13,34 +47,165 @@ struct benchmark_results {
 	unsigned long write_operations;
 	unsigned long create_operations;
 	unsigned long delete_operations;
+	unsigned long rename_operations;
+	unsigned long link_operations;
+	unsigned long stat_operations;
+	unsigned long readdir_operations;
+	unsigned long copy_operations;
+	unsigned long clone_operations;
 
 	size_t bytes_read;
 	size_t bytes_written;
+	unsigned long readdir_entries;
+	size_t bytes_copied;
+	size_t bytes_cloned;
+	/*
+	 * Copies done by reading and writing, and clones done by copying,
+	 * because the filesystem doesn't support them.
+	 */
+	unsigned long copy_fallbacks;
+	unsigned long clone_fallbacks;
+
+	/* System calls which read or wrote file data. */
+	unsigned long read_syscalls;
+	unsigned long write_syscalls;
+	/* I/O which would have blocked with the nowait flag and was retried. */
+	unsigned long nowait_retries;
+
+	/* Only used with verify. */
+	size_t bytes_verified;
+	unsigned long verify_errors;
+	uint64_t checksum_nsecs;
+
+	/*
+	 * Writes to hot files, which are also counted as writes. Their time is
+	 * split into waiting for the lock and the rest of the write.
+	 */
+	unsigned long hot_appends;
+	unsigned long hot_updates;
+	struct histogram lock_wait;
+	struct histogram hot_io_latency;
+
+	/* Sizes of created files and of writes. */
+	struct histogram file_sizes;
+	struct histogram write_sizes;
+	/* Sizes of the initial files, in the first thread's results only. */
+	struct histogram initial_file_sizes;
+
+	/* Latency of successful operations in nanoseconds. */
+	struct histogram latency[NUM_OPS];
+};
+
+struct cleanup_results {
+	struct timespec elapsed_time;
+
+	unsigned long unlink_operations;
+	unsigned long rmdir_operations;
+
+	/* Latency of unlinks and rmdirs in nanoseconds. */
+	struct histogram latency;
 };
 
+struct live_slot;
+struct slow_log;
+
+struct file_table;
+
 struct benchmark_thread {
 	pthread_t thread;
 	struct benchmark_results results;
+	struct cleanup_results cleanup_results;
 	uint32_t prng_seed;
 	struct prng prng;
 	char *buffer;
+	/* Where to publish live statistics, or NULL. */
+	struct live_slot *live;
+	/* Target of the files this thread creates with per-thread placement. */
+	unsigned int target;
+	/* Target and file id of the last operation, or -1 if it had no file. */
+	unsigned int op_target;
+	long op_file;
+	/* Results broken down by target, or NULL if there is only one. */
+	struct benchmark_results *target_results;
+	/* Ring of slow operations, or NULL. */
+	struct slow_log *slow_log;
+	/* Files the thread works on: shared, or its own partition. */
+	struct file_table *files;
+};
+
+/* A directory which benchmark files are placed in. */
+struct target {
+	char *path;
+	int dirfd;
 };
 
+extern struct target *targets;
+extern unsigned int num_targets;
+
 extern pthread_barrier_t barrier;
 
+/* Names of the operations, as used in reports (defined in live.c). */
+extern const char * const operation_names[NUM_OPS];
+
+/**
+ * add_target - open a directory and add it to the benchmark targets
+ * @path: path of the directory
+ */
+int add_target(const char *path);
+
+/**
+ * io_buffer_size - size of the buffer each thread needs for I/O, which is one
+ * block, or as many blocks as are submitted at once with vectored I/O, or
+ * larger with verify so that records can be checksummed in batches
+ */
+size_t io_buffer_size(void);
+
 /**
  * init_benchmark_files - create initial set of files
+ * @threads: benchmark threads, which are given their file tables
+ * @num_threads: number of benchmark threads
+ * @prng_seed: seed used to generate the files
+ * @reuse: reuse the files described by the manifest in the first target if
+ * it matches the parameters and seed, and write a manifest for the files
+ * otherwise
  */
-int init_benchmark_files(uint32_t prng_seed);
+int init_benchmark_files(struct benchmark_thread *threads, int num_threads,
+			 uint32_t prng_seed, bool reuse);
 
 /**
- * uninit_benchmark - do any necessary post-benchmark cleanup
+ * uninit_benchmark - forget the set of files, after which
+ * init_benchmark_files() may be called again
  */
 void uninit_benchmark(void);
 
+/**
+ * reset_benchmark - reset the shared operation count before running the
+ * benchmark again
+ */
+void reset_benchmark(void);
+
+/**
+ * add_initial_file_sizes - add the sizes of the initial files to a thread's
+ * results, which should be the first thread's so that they are counted once
+ * @results: results to add to
+ */
+void add_initial_file_sizes(struct benchmark_results *results);
+
+/**
+ * workload_modifies_files - can the workload change the set of files or their
+ * contents?
+ */
+bool workload_modifies_files(void);
+
 /**
  * run_benchmark - run the benchmark
  */
 void *run_benchmark(void *arg);
 
+/**
+ * run_cleanup - remove all of the benchmark files, in parallel with other
+ * threads running run_cleanup()
+ */
+void *run_cleanup(void *arg);
+
 #endif /* BENCHMARK_H */
@@ -0,0 +1,230 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "compare.h"
+#include "json.h"
+#include "report.h"
+#include "stats.h"
+
+/* Tail latency percentiles which are checked for regressions. */
+static const double tail_percentiles[] = {99.0, 99.9};
+static const char * const tail_percentile_names[] = {"p99", "p99.9"};
+#define NUM_TAIL_PERCENTILES \
+	(sizeof(tail_percentiles) / sizeof(tail_percentiles[0]))
+
+/*
+ * A tail percentile is only tested if at least this many operations are
+ * expected to be slower than it in both runs.
+ */
+#define MIN_TAIL_OPERATIONS 5
+
+static const char *verdict(bool regression, bool improvement)
+{
+	if (regression)
+		return "REGRESSION";
+	return improvement ? "improved" : "ok";
+}
+
+/*
+ * Each trial's throughput is a sample, or each thread's if either run was a
+ * single trial; the means are compared with a one-sided Welch's t-test.
+ */
+static int compare_throughput(const struct json_value *baseline,
+			      const struct benchmark_thread *threads,
+			      int num_threads,
+			      const struct benchmark_results *trials,
+			      int num_trials, double tolerance)
+{
+	const struct json_value *baseline_rates;
+	struct sample_stats baseline_stats, current_stats;
+	bool per_trial, significant, regression;
+	const char *unit;
+	double change;
+
+	baseline_rates = json_get(json_get(baseline, "trials"),
+				  "operations_per_second");
+	per_trial = (num_trials > 1 && baseline_rates &&
+		     baseline_rates->type == JSON_ARRAY &&
+		     baseline_rates->length > 1);
+	if (per_trial) {
+		double baseline_values[baseline_rates->length];
+		double current_values[num_trials];
+
+		for (size_t i = 0; i < baseline_rates->length; i++) {
+			baseline_values[i] = json_number(&baseline_rates->items[i],
+							 0.0);
+		}
+		for (int i = 0; i < num_trials; i++) {
+			current_values[i] = (total_operations(&trials[i]) /
+					     (elapsed_seconds(&trials[i].elapsed_time) /
+					      num_threads));
+		}
+		sample_stats(&baseline_stats, baseline_values,
+			     baseline_rates->length);
+		sample_stats(&current_stats, current_values, num_trials);
+		unit = "operations/sec";
+	} else {
+		const struct json_value *baseline_threads = json_get(baseline,
+								     "threads");
+		double baseline_values[baseline_threads->length];
+		double current_values[num_threads];
+
+		for (size_t i = 0; i < baseline_threads->length; i++) {
+			baseline_values[i] = json_number(json_get(&baseline_threads->items[i],
+								  "operations_per_second"),
+							 0.0);
+		}
+		for (int i = 0; i < num_threads; i++) {
+			const struct benchmark_results *results = &threads[i].results;
+
+			current_values[i] = (total_operations(results) /
+					     elapsed_seconds(&results->elapsed_time));
+		}
+		sample_stats(&baseline_stats, baseline_values,
+			     baseline_threads->length);
+		sample_stats(&current_stats, current_values, num_threads);
+		unit = "operations/sec/thread";
+	}
+	if (baseline_stats.mean <= 0.0) {
+		fprintf(stderr, "  Throughput: baseline has no operations\n");
+		return 0;
+	}
+
+	change = (current_stats.mean - baseline_stats.mean) / baseline_stats.mean;
+	fprintf(stderr, "  Throughput: %.2f -> %.2f %s (%+.1f%%",
+		baseline_stats.mean, current_stats.mean, unit, 100.0 * change);
+	if (baseline_stats.n >= 2 && current_stats.n >= 2) {
+		double t, df;
+
+		t = welch_t(&baseline_stats, &current_stats, &df);
+		significant = fabs(t) > t_critical(df, false);
+		fprintf(stderr, ", t=%.2f, df=%.1f", t, df);
+	} else {
+		/* There is no variance estimate from a single sample. */
+		significant = true;
+		fprintf(stderr, ", not tested for significance");
+	}
+	regression = significant && change < -tolerance;
+	fprintf(stderr, "): %s\n",
+		verdict(regression, significant && change > tolerance));
+	return regression;
+}
+
+/*
+ * A tail latency regression means that significantly more operations are
+ * slower than the baseline's percentile than in the baseline, which is tested
+ * with a one-sided two-proportion z-test.
+ */
+static int compare_tail(const char *name, const struct json_value *baseline,
+			const struct histogram *current, double tolerance)
+{
+	const struct json_value *buckets = json_get(baseline, "buckets");
+	double baseline_count = json_number(json_get(baseline, "count"), 0.0);
+	int regressions = 0;
+
+	if (baseline_count == 0.0 || current->count == 0 || !buckets ||
+	    buckets->type != JSON_ARRAY)
+		return 0;
+
+	for (size_t i = 0; i < NUM_TAIL_PERCENTILES; i++) {
+		double rank = ceil(tail_percentiles[i] / 100.0 * baseline_count);
+		double baseline_value = 0.0, seen = 0.0;
+		double baseline_slower = 0.0, current_slower = 0.0;
+		double expected_slower, current_value, change, z;
+		bool regression;
+
+		expected_slower = (1.0 - tail_percentiles[i] / 100.0);
+		if (expected_slower * baseline_count < MIN_TAIL_OPERATIONS ||
+		    expected_slower * current->count < MIN_TAIL_OPERATIONS)
+			continue;
+
+		for (size_t j = 0; j < buckets->length; j++) {
+			const struct json_value *bucket = &buckets->items[j];
+
+			if (bucket->type != JSON_ARRAY || bucket->length != 2)
+				continue;
+			seen += json_number(&bucket->items[1], 0.0);
+			if (seen >= rank) {
+				baseline_value = json_number(&bucket->items[0], 0.0);
+				break;
+			}
+		}
+		for (size_t j = 0; j < buckets->length; j++) {
+			const struct json_value *bucket = &buckets->items[j];
+
+			if (bucket->type == JSON_ARRAY && bucket->length == 2 &&
+			    json_number(&bucket->items[0], 0.0) > baseline_value)
+				baseline_slower += json_number(&bucket->items[1], 0.0);
+		}
+		for (int j = 0; j < HISTOGRAM_BUCKETS; j++) {
+			if (histogram_bucket_value(j) > baseline_value)
+				current_slower += current->buckets[j];
+		}
+		if (baseline_value <= 0.0)
+			continue;
+
+		current_value = histogram_percentile(current, tail_percentiles[i]);
+		change = (current_value - baseline_value) / baseline_value;
+		z = proportion_z(baseline_slower, baseline_count,
+				 current_slower, current->count);
+		regression = z > Z_CRITICAL && change > tolerance;
+		regressions += regression;
+		fprintf(stderr,
+			"  %s %s latency: %.2f -> %.2f us (%+.1f%%, %.2f%% -> %.2f%% slower than baseline %s, z=%.2f): %s\n",
+			name, tail_percentile_names[i], baseline_value / 1000.0,
+			current_value / 1000.0, 100.0 * change,
+			100.0 * baseline_slower / baseline_count,
+			100.0 * current_slower / current->count,
+			tail_percentile_names[i], z,
+			verdict(regression, z < -Z_CRITICAL && change < -tolerance));
+	}
+
+	return regressions;
+}
+
+int compare_to_baseline(const char *path, double tolerance,
+			const struct run_results *run)
+{
+	int num_threads = run->meta->num_threads;
+	const struct json_value *format, *baseline_threads, *baseline_latency;
+	struct json_value *baseline;
+	int regressions = 0;
+
+	baseline = json_parse_file(path);
+	if (!baseline)
+		return -1;
+
+	format = json_get(baseline, "format");
+	baseline_threads = json_get(baseline, "threads");
+	baseline_latency = json_get(json_get(baseline, "total"), "latency_ns");
+	if (!format || format->type != JSON_STRING ||
+	    strcmp(format->string, "omark-results") != 0 ||
+	    !baseline_threads || baseline_threads->type != JSON_ARRAY ||
+	    baseline_threads->length == 0 || !baseline_latency) {
+		fprintf(stderr, "%s: not an OMark JSON report\n", path);
+		json_free(baseline);
+		return -1;
+	}
+
+	fprintf(stderr, "\nComparison with baseline %s (tolerance %.1f%%):\n",
+		path, 100.0 * tolerance);
+	if (baseline_threads->length != num_threads) {
+		fprintf(stderr, "  Warning: baseline ran %zu threads, not %d\n",
+			baseline_threads->length, num_threads);
+	}
+
+	regressions += compare_throughput(baseline, run->threads, num_threads,
+					  run->trials, run->num_trials,
+					  tolerance);
+	for (int i = 0; i < NUM_OPS; i++) {
+		regressions += compare_tail(operation_names[i],
+					    json_get(baseline_latency,
+						     operation_names[i]),
+					    &run->total->latency[i], tolerance);
+	}
+
+	fprintf(stderr, "  %d regression%s\n", regressions,
+		regressions == 1 ? "" : "s");
+	json_free(baseline);
+	return regressions;
+}
@@ -0,0 +1,23 @@
+/*
+ * Regression detection against a baseline report.
+ */
+
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#include "report.h"
+
+/**
+ * compare_to_baseline - compare results to a baseline JSON report and print
+ * the comparison to stderr
+ * @path: baseline JSON report written with -f json
+ * @tolerance: smallest relative change (e.g., 0.05) which counts as a
+ * regression
+ * @run: results of the run
+ *
+ * Returns the number of regressions found or -1 on error.
+ */
+int compare_to_baseline(const char *path, double tolerance,
+			const struct run_results *run);
+
+#endif /* COMPARE_H */
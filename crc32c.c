@@ -0,0 +1,128 @@
+/*
+ * CRC32C using the SSE 4.2 or ARMv8 CRC instructions when available and
+ * slicing-by-8 otherwise.
+ */
+
+#include <string.h>
+#include "crc32c.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define HAVE_CRC32C_SSE42
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define HAVE_CRC32C_ARMV8
+#endif
+
+/* Reflected Castagnoli polynomial. */
+#define CRC32C_POLY UINT32_C(0x82f63b78)
+
+static uint32_t crc32c_table[8][256];
+
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	while (len >= 8) {
+		crc ^= ((uint32_t)p[0] | (uint32_t)p[1] << 8 |
+			(uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+		crc = (crc32c_table[7][crc & 0xff] ^
+		       crc32c_table[6][(crc >> 8) & 0xff] ^
+		       crc32c_table[5][(crc >> 16) & 0xff] ^
+		       crc32c_table[4][crc >> 24] ^
+		       crc32c_table[3][p[4]] ^
+		       crc32c_table[2][p[5]] ^
+		       crc32c_table[1][p[6]] ^
+		       crc32c_table[0][p[7]]);
+		p += 8;
+		len -= 8;
+	}
+
+	while (len--)
+		crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#ifdef HAVE_CRC32C_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+#ifdef __x86_64__
+	uint64_t crc64 = crc;
+
+	while (len >= 8) {
+		uint64_t word;
+
+		memcpy(&word, p, sizeof(word));
+		crc64 = _mm_crc32_u64(crc64, word);
+		p += 8;
+		len -= 8;
+	}
+	crc = crc64;
+#endif
+	while (len >= 4) {
+		uint32_t word;
+
+		memcpy(&word, p, sizeof(word));
+		crc = _mm_crc32_u32(crc, word);
+		p += 4;
+		len -= 4;
+	}
+	while (len--)
+		crc = _mm_crc32_u8(crc, *p++);
+
+	return crc;
+}
+#elif defined(HAVE_CRC32C_ARMV8)
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	while (len >= 8) {
+		uint64_t word;
+
+		memcpy(&word, p, sizeof(word));
+		crc = __crc32cd(crc, word);
+		p += 8;
+		len -= 8;
+	}
+	while (len--)
+		crc = __crc32cb(crc, *p++);
+
+	return crc;
+}
+#endif
+
+static uint32_t (*crc32c_fn)(uint32_t, const unsigned char *, size_t) = crc32c_sw;
+
+void crc32c_init(void)
+{
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+
+		for (int j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0);
+		crc32c_table[0][i] = crc;
+	}
+	for (uint32_t i = 0; i < 256; i++) {
+		for (int j = 1; j < 8; j++) {
+			uint32_t crc = crc32c_table[j - 1][i];
+
+			crc32c_table[j][i] = (crc >> 8) ^ crc32c_table[0][crc & 0xff];
+		}
+	}
+
+#if defined(HAVE_CRC32C_SSE42)
+	if (__builtin_cpu_supports("sse4.2"))
+		crc32c_fn = crc32c_hw;
+#elif defined(HAVE_CRC32C_ARMV8)
+	crc32c_fn = crc32c_hw;
+#endif
+}
+
+const char *crc32c_impl(void)
+{
+	return crc32c_fn == crc32c_sw ? "software" : "hardware";
+}
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	return ~crc32c_fn(~crc, buf, len);
+}
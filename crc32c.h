@@ -0,0 +1,30 @@
+/*
+ * CRC32C (Castagnoli) checksum.
+ */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * crc32c_init - pick the fastest available implementation; must be called
+ * before crc32c()
+ */
+void crc32c_init(void);
+
+/**
+ * crc32c_impl - name of the implementation picked by crc32c_init()
+ */
+const char *crc32c_impl(void);
+
+/**
+ * crc32c - update a CRC32C checksum
+ * @crc: checksum of the preceding data, or 0 to start a new checksum
+ * @buf: data to checksum
+ * @len: length of the data
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+#endif /* CRC32C_H */
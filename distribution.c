@@ -0,0 +1,225 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "distribution.h"
+
+#define NUM_QUANTILES (1 << DIST_QUANTILE_BITS)
+
+bool parse_distribution(struct size_distribution *dist, const char *spec)
+{
+	char type[16], path[1024];
+	int n = 0;
+
+	if (sscanf(spec, "%15s %n", type, &n) != 1)
+		return false;
+	spec += n;
+
+	if (strcmp(type, "uniform") == 0) {
+		dist->type = DIST_UNIFORM;
+		return true;
+	} else if (strcmp(type, "lognormal") == 0) {
+		if (sscanf(spec, "%lf %lf", &dist->median, &dist->sigma) != 2 ||
+		    dist->median <= 0.0 || dist->sigma <= 0.0)
+			return false;
+		dist->type = DIST_LOGNORMAL;
+		return true;
+	} else if (strcmp(type, "pareto") == 0) {
+		if (sscanf(spec, "%lf", &dist->alpha) != 1 || dist->alpha <= 0.0)
+			return false;
+		dist->type = DIST_PARETO;
+		return true;
+	} else if (strcmp(type, "empirical") == 0) {
+		if (sscanf(spec, "%1023s", path) != 1)
+			return false;
+		free(dist->path);
+		dist->path = strdup(path);
+		if (!dist->path) {
+			perror("strdup");
+			return false;
+		}
+		dist->type = DIST_EMPIRICAL;
+		return true;
+	}
+	return false;
+}
+
+/*
+ * An empirical histogram file has one "SIZE WEIGHT" line per bucket, in
+ * increasing order of size. Each bucket contains the sizes greater than the
+ * previous bucket's size up to and including its own size, and sizes are
+ * uniformly distributed within a bucket.
+ */
+static int load_histogram(struct size_distribution *dist)
+{
+	FILE *file;
+	char *line = NULL;
+	size_t n = 0, capacity = 0;
+	int lineno = 0;
+	int status = -1;
+
+	file = fopen(dist->path, "r");
+	if (!file) {
+		perror(dist->path);
+		return -1;
+	}
+
+	dist->num_buckets = 0;
+	dist->hash = UINT32_C(2166136261);
+	while (getline(&line, &n, file) != -1) {
+		double size, weight;
+		char *p;
+
+		lineno++;
+		for (p = line; *p; p++)
+			dist->hash = (dist->hash ^ (unsigned char)*p) * UINT32_C(16777619);
+		p = line + strspn(line, " \t\n");
+		if (*p == '\0' || *p == '#')
+			continue;
+
+		if (sscanf(p, "%lf %lf", &size, &weight) != 2 || weight < 0.0 ||
+		    size <= (dist->num_buckets ? dist->bounds[dist->num_buckets] : 0.0)) {
+			fprintf(stderr, "%s:%d: invalid histogram bucket: %s",
+				dist->path, lineno, line);
+			goto out;
+		}
+
+		if (dist->num_buckets + 2 > capacity) {
+			double *bounds, *weights;
+
+			capacity = capacity * 2 + 2;
+			bounds = realloc(dist->bounds, capacity * sizeof(*bounds));
+			if (bounds)
+				dist->bounds = bounds;
+			weights = realloc(dist->weights, capacity * sizeof(*weights));
+			if (weights)
+				dist->weights = weights;
+			if (!bounds || !weights) {
+				perror("realloc");
+				goto out;
+			}
+		}
+		if (dist->num_buckets == 0)
+			dist->bounds[0] = 0.0;
+		dist->bounds[dist->num_buckets + 1] = size;
+		dist->weights[dist->num_buckets] = weight;
+		dist->num_buckets++;
+	}
+	if (ferror(file)) {
+		perror("getline");
+		goto out;
+	}
+	if (dist->num_buckets == 0) {
+		fprintf(stderr, "%s: empty histogram\n", dist->path);
+		goto out;
+	}
+	status = 0;
+
+out:
+	free(line);
+	fclose(file);
+	return status;
+}
+
+/* Cumulative distribution function, not normalized for empirical histograms. */
+static double cdf(const struct size_distribution *dist, double x)
+{
+	double total = 0.0;
+
+	switch (dist->type) {
+	case DIST_LOGNORMAL:
+		if (x <= 0.0)
+			return 0.0;
+		return 0.5 * erfc(-(log(x) - log(dist->median)) /
+				  (dist->sigma * sqrt(2.0)));
+	case DIST_PARETO:
+		if (x <= (dist->min ? dist->min : 1))
+			return 0.0;
+		return 1.0 - pow((dist->min ? dist->min : 1) / x, dist->alpha);
+	case DIST_EMPIRICAL:
+		for (size_t i = 0; i < dist->num_buckets; i++) {
+			double low = dist->bounds[i], high = dist->bounds[i + 1];
+
+			if (x >= high) {
+				total += dist->weights[i];
+			} else {
+				if (x > low)
+					total += dist->weights[i] * (x - low) / (high - low);
+				break;
+			}
+		}
+		return total;
+	default:
+		return 0.0;
+	}
+}
+
+int distribution_init(struct size_distribution *dist, size_t min, size_t max)
+{
+	double cdf_min, cdf_max;
+
+	dist->min = min;
+	dist->max = max;
+	if (min > max) {
+		fprintf(stderr, "minimum size is greater than maximum size\n");
+		return -1;
+	}
+	if (dist->type == DIST_UNIFORM)
+		return 0;
+
+	if (dist->type == DIST_EMPIRICAL && load_histogram(dist) == -1)
+		return -1;
+
+	/* Truncate the distribution to [min, max]. */
+	cdf_min = cdf(dist, min);
+	cdf_max = cdf(dist, max);
+	if (!(cdf_max > cdf_min)) {
+		fprintf(stderr, "size distribution is empty between %zu and %zu\n",
+			min, max);
+		return -1;
+	}
+
+	free(dist->quantiles);
+	dist->quantiles = malloc((NUM_QUANTILES + 1) * sizeof(dist->quantiles[0]));
+	if (!dist->quantiles) {
+		perror("malloc");
+		return -1;
+	}
+
+	/* Invert the CDF by bisection. */
+	for (int i = 0; i <= NUM_QUANTILES; i++) {
+		double target = cdf_min + (cdf_max - cdf_min) * i / NUM_QUANTILES;
+		double low = min, high = max;
+
+		for (int j = 0; j < 64 && high - low > 0.5; j++) {
+			double mid = low + (high - low) / 2.0;
+
+			if (cdf(dist, mid) < target)
+				low = mid;
+			else
+				high = mid;
+		}
+		dist->quantiles[i] = llround(low + (high - low) / 2.0);
+	}
+
+	return 0;
+}
+
+void describe_distribution(const struct size_distribution *dist, char *buf,
+			   size_t size)
+{
+	switch (dist->type) {
+	case DIST_UNIFORM:
+		snprintf(buf, size, "uniform");
+		break;
+	case DIST_LOGNORMAL:
+		snprintf(buf, size, "lognormal %.17g %.17g", dist->median,
+			 dist->sigma);
+		break;
+	case DIST_PARETO:
+		snprintf(buf, size, "pareto %.17g", dist->alpha);
+		break;
+	case DIST_EMPIRICAL:
+		snprintf(buf, size, "empirical %s", dist->path);
+		break;
+	}
+}
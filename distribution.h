@@ -0,0 +1,91 @@
+/*
+ * File and write size distributions.
+ */
+
+#ifndef DISTRIBUTION_H
+#define DISTRIBUTION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "prng.h"
+
+enum distribution_type {
+	DIST_UNIFORM,
+	DIST_LOGNORMAL,
+	DIST_PARETO,
+	DIST_EMPIRICAL,
+};
+
+/*
+ * log2 of the number of points that the inverse CDF of a non-uniform
+ * distribution is tabulated at. Sampling interpolates between them.
+ */
+#define DIST_QUANTILE_BITS 12
+
+struct size_distribution {
+	enum distribution_type type;
+	/* Log-normal parameters. */
+	double median, sigma;
+	/* Pareto shape; the scale is the minimum size. */
+	double alpha;
+	/* Empirical histogram file. */
+	char *path;
+
+	/* Everything below is set by distribution_init(). */
+	size_t min, max;
+	/* Empirical histogram buckets (bounds[i], bounds[i + 1]]. */
+	size_t num_buckets;
+	double *bounds, *weights;
+	uint32_t hash;
+	uint64_t *quantiles;
+};
+
+/**
+ * parse_distribution - parse a distribution specification
+ * @dist: distribution to update
+ * @spec: the specification, e.g., "lognormal 4096 1.5"
+ */
+bool parse_distribution(struct size_distribution *dist, const char *spec);
+
+/**
+ * distribution_init - prepare a distribution for sampling
+ * @dist: the distribution
+ * @min: minimum size to generate
+ * @max: maximum size to generate
+ */
+int distribution_init(struct size_distribution *dist, size_t min, size_t max);
+
+/**
+ * distribution_sample - generate a random size
+ * @dist: the distribution
+ * @prng: the PRNG
+ */
+static inline size_t distribution_sample(const struct size_distribution *dist,
+					 struct prng *prng)
+{
+	uint32_t word, frac;
+	uint64_t low, high;
+
+	if (dist->type == DIST_UNIFORM)
+		return prng_range(prng, dist->min, dist->max + 1);
+
+	word = prng_u32(prng);
+	low = dist->quantiles[word >> (32 - DIST_QUANTILE_BITS)];
+	high = dist->quantiles[(word >> (32 - DIST_QUANTILE_BITS)) + 1];
+	frac = word & ((UINT32_C(1) << (32 - DIST_QUANTILE_BITS)) - 1);
+	return low + (((high - low) * frac) >> (32 - DIST_QUANTILE_BITS));
+}
+
+/**
+ * describe_distribution - format a distribution specification which
+ * parse_distribution() accepts
+ * @dist: the distribution
+ * @buf: buffer to format into
+ * @size: size of the buffer
+ */
+void describe_distribution(const struct size_distribution *dist, char *buf,
+			   size_t size);
+
+#endif /* DISTRIBUTION_H */
@@ -0,0 +1,80 @@
+#include "histogram.h"
+
+#define SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+
+static inline int bucket_index(uint64_t value)
+{
+	int shift;
+
+	if (value < SUB_BUCKETS)
+		return value;
+
+	shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS;
+	return (((shift + 1) << HISTOGRAM_SUB_BITS) +
+		((value >> shift) & (SUB_BUCKETS - 1)));
+}
+
+uint64_t histogram_bucket_value(int index)
+{
+	int shift;
+
+	if (index < SUB_BUCKETS)
+		return index;
+
+	shift = (index >> HISTOGRAM_SUB_BITS) - 1;
+	return ((((uint64_t)SUB_BUCKETS + (index & (SUB_BUCKETS - 1)) + 1)
+		 << shift) - 1);
+}
+
+void histogram_record(struct histogram *hist, uint64_t value)
+{
+	if (hist->count == 0 || value < hist->min)
+		hist->min = value;
+	if (value > hist->max)
+		hist->max = value;
+	hist->count++;
+	hist->sum += value;
+	hist->buckets[bucket_index(value)]++;
+}
+
+void histogram_merge(struct histogram *dst, const struct histogram *src)
+{
+	if (src->count == 0)
+		return;
+
+	if (dst->count == 0 || src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	dst->count += src->count;
+	dst->sum += src->sum;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+}
+
+uint64_t histogram_percentile(const struct histogram *hist, double percentile)
+{
+	uint64_t rank, seen = 0;
+	double exact_rank;
+
+	if (hist->count == 0)
+		return 0;
+
+	exact_rank = percentile / 100.0 * hist->count;
+	rank = exact_rank;
+	if (rank < exact_rank)
+		rank++;
+	if (rank == 0)
+		rank = 1;
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += hist->buckets[i];
+		if (seen >= rank) {
+			uint64_t value = histogram_bucket_value(i);
+
+			if (value > hist->max)
+				return hist->max;
+			return value > hist->min ? value : hist->min;
+		}
+	}
+	return hist->max;
+}
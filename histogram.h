@@ -0,0 +1,55 @@
+/*
+ * Log-linear latency histograms.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+ * Each power of two is split into 2^HISTOGRAM_SUB_BITS buckets, so a value is
+ * recorded with at most 1/2^HISTOGRAM_SUB_BITS relative error.
+ */
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+struct histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+/**
+ * histogram_record - record a value in a histogram
+ * @hist: the histogram, which must be zero-initialized before first use
+ * @value: the value (e.g., a latency in nanoseconds)
+ */
+void histogram_record(struct histogram *hist, uint64_t value);
+
+/**
+ * histogram_merge - add all of the values in one histogram to another
+ * @dst: histogram to add to
+ * @src: histogram to add from
+ */
+void histogram_merge(struct histogram *dst, const struct histogram *src);
+
+/**
+ * histogram_percentile - estimate a percentile of the recorded values
+ * @hist: the histogram
+ * @percentile: the percentile, from 0 to 100
+ *
+ * Returns the upper bound of the bucket containing the percentile, or 0 if the
+ * histogram is empty.
+ */
+uint64_t histogram_percentile(const struct histogram *hist, double percentile);
+
+/**
+ * histogram_bucket_value - upper bound of the values recorded in a bucket
+ * @index: bucket index
+ */
+uint64_t histogram_bucket_value(int index);
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <string.h>
+#include "json.h"
+
+/* Nesting limit, which keeps the recursive parser's stack bounded. */
+#define JSON_MAX_DEPTH 64
+
+struct json_parser {
+	const char *path;
+	const char *p;
+	int line;
+};
+
+static int json_error(struct json_parser *parser, const char *what)
+{
+	fprintf(stderr, "%s:%d: %s\n", parser->path, parser->line, what);
+	return -1;
+}
+
+static void skip_whitespace(struct json_parser *parser)
+{
+	while (*parser->p == ' ' || *parser->p == '\t' || *parser->p == '\n' ||
+	       *parser->p == '\r') {
+		if (*parser->p == '\n')
+			parser->line++;
+		parser->p++;
+	}
+}
+
+static int parse_value(struct json_parser *parser, struct json_value *value,
+		       int depth);
+
+/* Only the escapes that json_write_string() emits are supported. */
+static int parse_string(struct json_parser *parser, char **ret)
+{
+	const char *start = ++parser->p;
+	char *str, *q;
+
+	while (*parser->p != '"') {
+		if (*parser->p == '\0' || *parser->p == '\n')
+			return json_error(parser, "unterminated string");
+		if (*parser->p == '\\' && parser->p[1])
+			parser->p++;
+		parser->p++;
+	}
+
+	str = q = malloc(parser->p - start + 1);
+	if (!str) {
+		perror("malloc");
+		return -1;
+	}
+	for (const char *s = start; s < parser->p; s++) {
+		if (*s != '\\') {
+			*q++ = *s;
+			continue;
+		}
+		switch (*++s) {
+		case 'n':
+			*q++ = '\n';
+			break;
+		case 't':
+			*q++ = '\t';
+			break;
+		case 'u':
+			/* Control characters only. */
+			if (strncmp(s + 1, "00", 2) == 0 && s + 4 < parser->p) {
+				char hex[3] = {s[3], s[4], '\0'};
+
+				*q++ = strtol(hex, NULL, 16);
+				s += 4;
+				break;
+			}
+			free(str);
+			return json_error(parser, "unsupported string escape");
+		default:
+			*q++ = *s;
+			break;
+		}
+	}
+	*q = '\0';
+	parser->p++;
+	*ret = str;
+	return 0;
+}
+
+static int parse_items(struct json_parser *parser, struct json_value *value,
+		       int depth, bool object)
+{
+	char close = object ? '}' : ']';
+	size_t capacity = 0;
+
+	parser->p++;
+	skip_whitespace(parser);
+	if (*parser->p == close) {
+		parser->p++;
+		return 0;
+	}
+
+	for (;;) {
+		if (value->length >= capacity) {
+			struct json_value *items;
+			char **keys;
+
+			capacity = capacity * 2 + 4;
+			items = realloc(value->items, capacity * sizeof(*items));
+			if (!items) {
+				perror("realloc");
+				return -1;
+			}
+			value->items = items;
+			if (object) {
+				keys = realloc(value->keys, capacity * sizeof(*keys));
+				if (!keys) {
+					perror("realloc");
+					return -1;
+				}
+				value->keys = keys;
+			}
+		}
+
+		memset(&value->items[value->length], 0, sizeof(value->items[0]));
+		if (object) {
+			skip_whitespace(parser);
+			if (*parser->p != '"')
+				return json_error(parser, "expected member name");
+			if (parse_string(parser, &value->keys[value->length]) == -1)
+				return -1;
+			skip_whitespace(parser);
+			if (*parser->p != ':') {
+				value->length++;
+				return json_error(parser, "expected ':'");
+			}
+			parser->p++;
+		}
+		value->length++;
+		if (parse_value(parser, &value->items[value->length - 1],
+				depth + 1) == -1)
+			return -1;
+
+		skip_whitespace(parser);
+		if (*parser->p == close) {
+			parser->p++;
+			return 0;
+		} else if (*parser->p != ',') {
+			return json_error(parser, object ? "expected ',' or '}'" :
+					  "expected ',' or ']'");
+		}
+		parser->p++;
+	}
+}
+
+static int parse_value(struct json_parser *parser, struct json_value *value,
+		       int depth)
+{
+	char *end;
+
+	if (depth > JSON_MAX_DEPTH)
+		return json_error(parser, "nested too deeply");
+
+	skip_whitespace(parser);
+	switch (*parser->p) {
+	case '{':
+		value->type = JSON_OBJECT;
+		return parse_items(parser, value, depth, true);
+	case '[':
+		value->type = JSON_ARRAY;
+		return parse_items(parser, value, depth, false);
+	case '"':
+		value->type = JSON_STRING;
+		return parse_string(parser, &value->string);
+	case 't':
+	case 'f':
+	case 'n':
+		if (strncmp(parser->p, "true", 4) == 0) {
+			value->type = JSON_BOOLEAN;
+			value->boolean = true;
+			parser->p += 4;
+		} else if (strncmp(parser->p, "false", 5) == 0) {
+			value->type = JSON_BOOLEAN;
+			value->boolean = false;
+			parser->p += 5;
+		} else if (strncmp(parser->p, "null", 4) == 0) {
+			value->type = JSON_NULL;
+			parser->p += 4;
+		} else {
+			return json_error(parser, "invalid literal");
+		}
+		return 0;
+	default:
+		value->type = JSON_NUMBER;
+		value->number = strtod(parser->p, &end);
+		if (end == parser->p)
+			return json_error(parser, "expected value");
+		parser->p = end;
+		return 0;
+	}
+}
+
+static void free_value(struct json_value *value)
+{
+	for (size_t i = 0; i < value->length; i++) {
+		free_value(&value->items[i]);
+		if (value->keys)
+			free(value->keys[i]);
+	}
+	free(value->items);
+	free(value->keys);
+	free(value->string);
+}
+
+void json_free(struct json_value *value)
+{
+	if (value) {
+		free_value(value);
+		free(value);
+	}
+}
+
+struct json_value *json_parse_file(const char *path)
+{
+	struct json_parser parser = {.path = path, .line = 1};
+	struct json_value *value = NULL;
+	char *text = NULL;
+	size_t size = 0;
+	FILE *file;
+
+	file = fopen(path, "r");
+	if (!file) {
+		perror(path);
+		return NULL;
+	}
+	if (getdelim(&text, &size, '\0', file) == -1 && ferror(file)) {
+		perror(path);
+		goto out;
+	}
+	if (!text)
+		text = calloc(1, 1);
+
+	value = calloc(1, sizeof(*value));
+	if (!value || !text) {
+		perror("calloc");
+		goto out;
+	}
+	parser.p = text;
+	if (parse_value(&parser, value, 0) == -1) {
+		json_free(value);
+		value = NULL;
+		goto out;
+	}
+	skip_whitespace(&parser);
+	if (*parser.p != '\0') {
+		json_error(&parser, "trailing characters");
+		json_free(value);
+		value = NULL;
+	}
+
+out:
+	free(text);
+	fclose(file);
+	return value;
+}
+
+const struct json_value *json_get(const struct json_value *value,
+				  const char *key)
+{
+	if (!value || value->type != JSON_OBJECT)
+		return NULL;
+	for (size_t i = 0; i < value->length; i++) {
+		if (strcmp(value->keys[i], key) == 0)
+			return &value->items[i];
+	}
+	return NULL;
+}
+
+double json_number(const struct json_value *value, double default_value)
+{
+	if (!value || value->type != JSON_NUMBER)
+		return default_value;
+	return value->number;
+}
+
+void json_write_string(FILE *file, const char *str)
+{
+	fputc('"', file);
+	for (; *str; str++) {
+		unsigned char c = *str;
+
+		if (c == '"' || c == '\\')
+			fprintf(file, "\\%c", c);
+		else if (c == '\n')
+			fputs("\\n", file);
+		else if (c == '\t')
+			fputs("\\t", file);
+		else if (c < 0x20)
+			fprintf(file, "\\u%04x", c);
+		else
+			fputc(c, file);
+	}
+	fputc('"', file);
+}
@@ -0,0 +1,72 @@
+/*
+ * Minimal JSON support, for writing results and reading them back.
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+enum json_type {
+	JSON_NULL,
+	JSON_BOOLEAN,
+	JSON_NUMBER,
+	JSON_STRING,
+	JSON_ARRAY,
+	JSON_OBJECT,
+};
+
+struct json_value {
+	enum json_type type;
+	bool boolean;
+	double number;
+	char *string;
+	/* Array elements or object members. */
+	size_t length;
+	struct json_value *items;
+	/* Object member names. */
+	char **keys;
+};
+
+/**
+ * json_parse_file - parse a JSON file
+ * @path: file to parse
+ *
+ * Returns the parsed value, which must be freed with json_free(), or NULL on
+ * error.
+ */
+struct json_value *json_parse_file(const char *path);
+
+/**
+ * json_free - free a value returned by json_parse_file()
+ * @value: the value
+ */
+void json_free(struct json_value *value);
+
+/**
+ * json_get - look up an object member
+ * @value: the object
+ * @key: the member name
+ *
+ * Returns NULL if value is NULL, is not an object, or has no such member.
+ */
+const struct json_value *json_get(const struct json_value *value,
+				  const char *key);
+
+/**
+ * json_number - get the value of a number
+ * @value: the number
+ * @default_value: value to return if value is NULL or not a number
+ */
+double json_number(const struct json_value *value, double default_value);
+
+/**
+ * json_write_string - write a string as a quoted JSON string
+ * @file: file to write to
+ * @str: the string
+ */
+void json_write_string(FILE *file, const char *str);
+
+#endif /* JSON_H */
@@ -0,0 +1,171 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "live.h"
+
+/* Number of times to retry reading a slot which is being written. */
+#define LIVE_READ_RETRIES 1000
+
+/* Here rather than in benchmark.c so that omark-top shares it. */
+const char * const operation_names[NUM_OPS] = {
+	[OP_READ] = "read",
+	[OP_WRITE] = "write",
+	[OP_CREATE] = "create",
+	[OP_DELETE] = "delete",
+	[OP_RENAME] = "rename",
+	[OP_LINK] = "link",
+	[OP_STAT] = "stat",
+	[OP_READDIR] = "readdir",
+	[OP_COPY] = "copy",
+	[OP_CLONE] = "clone",
+};
+
+static void segment_name(char *buf, size_t size, const char *name)
+{
+	snprintf(buf, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+struct live_stats *live_create(const char *name, int num_threads,
+			       int num_trials)
+{
+	struct live_stats *live;
+	char path[NAME_MAX];
+	size_t size;
+	int fd;
+
+	segment_name(path, sizeof(path), name);
+	size = sizeof(*live) + num_threads * sizeof(live->slots[0]);
+	fd = shm_open(path, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd == -1) {
+		perror("shm_open");
+		return NULL;
+	}
+	if (ftruncate(fd, size) == -1) {
+		perror("ftruncate");
+		close(fd);
+		shm_unlink(path);
+		return NULL;
+	}
+	live = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (live == MAP_FAILED) {
+		perror("mmap");
+		shm_unlink(path);
+		return NULL;
+	}
+
+	live->header.version = LIVE_VERSION;
+	live->header.slot_size = sizeof(live->slots[0]);
+	live->header.num_threads = num_threads;
+	live->header.pid = getpid();
+	live->header.state = LIVE_STARTING;
+	live->header.num_trials = num_trials;
+	/* The magic number goes last so that readers see a complete header. */
+	__atomic_store_n(&live->header.magic, LIVE_MAGIC, __ATOMIC_RELEASE);
+	return live;
+}
+
+const struct live_stats *live_attach(const char *name, size_t *size_ret)
+{
+	const struct live_stats *live;
+	char path[NAME_MAX];
+	struct stat st;
+	int fd;
+
+	segment_name(path, sizeof(path), name);
+	fd = shm_open(path, O_RDONLY, 0);
+	if (fd == -1) {
+		perror(path);
+		return NULL;
+	}
+	if (fstat(fd, &st) == -1) {
+		perror("fstat");
+		close(fd);
+		return NULL;
+	}
+	if (st.st_size < sizeof(*live)) {
+		fprintf(stderr, "%s: not a live statistics segment\n", path);
+		close(fd);
+		return NULL;
+	}
+	live = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (live == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+
+	if (__atomic_load_n(&live->header.magic, __ATOMIC_ACQUIRE) != LIVE_MAGIC ||
+	    live->header.version != LIVE_VERSION ||
+	    live->header.slot_size != sizeof(live->slots[0]) ||
+	    st.st_size < (sizeof(*live) +
+			  live->header.num_threads * sizeof(live->slots[0]))) {
+		fprintf(stderr, "%s: not a compatible live statistics segment\n",
+			path);
+		munmap((void *)live, st.st_size);
+		return NULL;
+	}
+	*size_ret = st.st_size;
+	return live;
+}
+
+void live_unlink(const char *name)
+{
+	char path[NAME_MAX];
+
+	segment_name(path, sizeof(path), name);
+	if (shm_unlink(path) == -1)
+		perror("shm_unlink");
+}
+
+void live_set_state(struct live_stats *live, enum live_state state, int trial)
+{
+	__atomic_store_n(&live->header.trial, trial, __ATOMIC_RELAXED);
+	__atomic_store_n(&live->header.state, state, __ATOMIC_RELEASE);
+}
+
+void live_publish(struct live_slot *slot,
+		  const struct benchmark_results *results,
+		  uint64_t elapsed_nsecs)
+{
+	uint64_t seq = slot->seq;
+
+	__atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	slot->elapsed_nsecs = elapsed_nsecs;
+	slot->operations[OP_READ] = results->read_operations;
+	slot->operations[OP_WRITE] = results->write_operations;
+	slot->operations[OP_CREATE] = results->create_operations;
+	slot->operations[OP_DELETE] = results->delete_operations;
+	slot->operations[OP_RENAME] = results->rename_operations;
+	slot->operations[OP_LINK] = results->link_operations;
+	slot->operations[OP_STAT] = results->stat_operations;
+	slot->operations[OP_READDIR] = results->readdir_operations;
+	slot->operations[OP_COPY] = results->copy_operations;
+	slot->operations[OP_CLONE] = results->clone_operations;
+	slot->bytes_read = results->bytes_read;
+	slot->bytes_written = results->bytes_written;
+	memcpy(slot->latency, results->latency, sizeof(slot->latency));
+
+	__atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+int live_read(const struct live_slot *slot, struct live_slot *snapshot)
+{
+	for (int i = 0; i < LIVE_READ_RETRIES; i++) {
+		uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+		if (seq & 1)
+			continue;
+		memcpy(snapshot, slot, sizeof(*snapshot));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+	return -1;
+}
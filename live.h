@@ -0,0 +1,115 @@
+/*
+ * Live statistics published in POSIX shared memory.
+ *
+ * The segment consists of a header followed by one slot per benchmark thread.
+ * Each slot has a single writer, the thread it belongs to, which periodically
+ * copies its results into the slot under a sequence counter (a seqlock): the
+ * counter is odd while the slot is being written, and readers retry if it was
+ * odd or changed while they copied the slot. Writers never wait for readers.
+ */
+
+#ifndef LIVE_H
+#define LIVE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "benchmark.h"
+#include "histogram.h"
+
+#define LIVE_MAGIC UINT32_C(0x4f4d4c56) /* "OMLV" */
+#define LIVE_VERSION 2
+
+/* How often a thread publishes its results. */
+#define LIVE_INTERVAL_NSECS UINT64_C(100000000)
+
+enum live_state {
+	LIVE_STARTING,
+	LIVE_CREATING,
+	LIVE_RUNNING,
+	LIVE_CLEANUP,
+	LIVE_DONE,
+};
+
+struct live_header {
+	uint32_t magic;
+	uint32_t version;
+	/* Size of a slot, which also catches layout mismatches. */
+	uint32_t slot_size;
+	uint32_t num_threads;
+	pid_t pid;
+	/* enum live_state, updated by the main thread. */
+	uint32_t state;
+	uint32_t trial;
+	uint32_t num_trials;
+} __attribute__((aligned(64)));
+
+struct live_slot {
+	uint64_t seq;
+	/* Nanoseconds since the thread started running the benchmark. */
+	uint64_t elapsed_nsecs;
+	uint64_t operations[NUM_OPS];
+	uint64_t bytes_read;
+	uint64_t bytes_written;
+	struct histogram latency[NUM_OPS];
+} __attribute__((aligned(64)));
+
+struct live_stats {
+	struct live_header header;
+	struct live_slot slots[];
+};
+
+/**
+ * live_create - create and map a shared-memory segment for live statistics
+ * @name: segment name; a leading '/' is added if it is missing
+ * @num_threads: number of benchmark threads
+ * @num_trials: number of trials
+ *
+ * Returns the mapped segment or NULL on error.
+ */
+struct live_stats *live_create(const char *name, int num_threads,
+			       int num_trials);
+
+/**
+ * live_attach - map an existing live statistics segment read-only
+ * @name: segment name; a leading '/' is added if it is missing
+ * @size_ret: returned size of the mapping
+ *
+ * Returns the mapped segment or NULL on error.
+ */
+const struct live_stats *live_attach(const char *name, size_t *size_ret);
+
+/**
+ * live_unlink - remove a live statistics segment
+ * @name: segment name; a leading '/' is added if it is missing
+ */
+void live_unlink(const char *name);
+
+/**
+ * live_set_state - publish the phase of the benchmark
+ * @live: live statistics segment
+ * @state: current phase
+ * @trial: current trial
+ */
+void live_set_state(struct live_stats *live, enum live_state state, int trial);
+
+/**
+ * live_publish - copy a thread's results into its slot
+ * @slot: the thread's slot
+ * @results: the thread's results
+ * @elapsed_nsecs: nanoseconds since the thread started running the benchmark
+ */
+void live_publish(struct live_slot *slot,
+		  const struct benchmark_results *results,
+		  uint64_t elapsed_nsecs);
+
+/**
+ * live_read - take a consistent snapshot of a slot
+ * @slot: slot to read
+ * @snapshot: returned snapshot
+ *
+ * Returns 0 on success or -1 if the slot kept changing (e.g., because its
+ * writer died in the middle of an update).
+ */
+int live_read(const struct live_slot *slot, struct live_slot *snapshot);
+
+#endif /* LIVE_H */
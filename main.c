@@ -1,5 +1,7 @@
 #include <errno.h>
 #include <limits.h>
+#include <math.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,12 +11,38 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include "benchmark.h"
+#include "compare.h"
+#include "crc32c.h"
+#include "live.h"
 #include "params.h"
 #include "prng.h"
+#include "remote.h"
+#include "report.h"
+#include "slowlog.h"
 
 static const char *progname;
 static struct benchmark_thread *threads;
 static int num_threads = 1;
+static struct live_stats *live;
+static char *live_name;
+static FILE *slow_log_file;
+/* Protects threads against dumps of the slow operation log on a signal. */
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+enum output_format {
+	FORMAT_VERBOSE,
+	FORMAT_TERSE,
+	FORMAT_JSON,
+	FORMAT_CSV,
+	NUM_FORMATS,
+};
+
+static const char * const format_names[] = {
+	[FORMAT_VERBOSE] = "verbose",
+	[FORMAT_TERSE] = "terse",
+	[FORMAT_JSON] = "json",
+	[FORMAT_CSV] = "csv",
+};
 
 static void print_human_readable_bytes(double bytes, int precision)
 {
@@ -27,14 +55,76 @@ static void print_human_readable_bytes(double bytes, int precision)
 	printf("%.*f %s", precision, bytes, units[i]);
 }
 
+static const char * const operation_labels[NUM_OPS] = {
+	[OP_READ] = "Read",
+	[OP_WRITE] = "Write",
+	[OP_CREATE] = "Create",
+	[OP_DELETE] = "Delete",
+	[OP_RENAME] = "Rename",
+	[OP_LINK] = "Link",
+	[OP_STAT] = "Stat",
+	[OP_READDIR] = "Readdir",
+	[OP_COPY] = "Copy",
+	[OP_CLONE] = "Clone",
+};
+
+static void print_latency(const char *name, const struct histogram *hist)
+{
+	if (hist->count == 0)
+		return;
+
+	printf("  %s latency: avg %.2f us, p50 %.2f us, p99 %.2f us, p99.9 %.2f us, max %.2f us\n",
+	       name, (double)hist->sum / hist->count / 1000.0,
+	       histogram_percentile(hist, 50.0) / 1000.0,
+	       histogram_percentile(hist, 99.0) / 1000.0,
+	       histogram_percentile(hist, 99.9) / 1000.0,
+	       hist->max / 1000.0);
+}
+
+static void print_sizes(const char *name, const struct histogram *hist)
+{
+	if (hist->count == 0)
+		return;
+
+	printf("  %s sizes: avg ", name);
+	print_human_readable_bytes((double)hist->sum / hist->count, 1);
+	printf(", p50 ");
+	print_human_readable_bytes(histogram_percentile(hist, 50.0), 1);
+	printf(", p90 ");
+	print_human_readable_bytes(histogram_percentile(hist, 90.0), 1);
+	printf(", p99 ");
+	print_human_readable_bytes(histogram_percentile(hist, 99.0), 1);
+	printf(", max ");
+	print_human_readable_bytes(hist->max, 1);
+	printf("\n");
+}
+
+static void print_syscalls(const char *name, unsigned long syscalls,
+			   size_t bytes)
+{
+	if (syscalls == 0)
+		return;
+
+	printf("  %s system calls: %lu (", name, syscalls);
+	print_human_readable_bytes((double)bytes / syscalls, 1);
+	printf("/call, %zu-byte blocks)\n", block_size);
+}
+
 static void verbose_print_results(const struct benchmark_results *results,
 				  double elapsed_secs)
 {
 	unsigned long total_operations, io_operations, dir_operations;
+	unsigned long meta_operations, copy_operations;
 
 	io_operations = results->read_operations + results->write_operations;
 	dir_operations = results->create_operations + results->delete_operations;
-	total_operations = io_operations + dir_operations;
+	meta_operations = (results->rename_operations +
+			   results->link_operations +
+			   results->stat_operations +
+			   results->readdir_operations);
+	copy_operations = results->copy_operations + results->clone_operations;
+	total_operations = (io_operations + dir_operations + meta_operations +
+			    copy_operations);
 
 	printf("  Total operations: %lu (%.2f/sec)\n",
 	       total_operations, total_operations / elapsed_secs);
@@ -49,6 +139,20 @@ static void verbose_print_results(const struct benchmark_results *results,
 	       100.0 * ((double)dir_operations / (double)total_operations),
 	       dir_operations / elapsed_secs);
 
+	if (meta_operations) {
+		printf("  Metadata (rename/link/stat/readdir) operations: %lu (%.1f%%, %.2f/sec)\n",
+		       meta_operations,
+		       100.0 * ((double)meta_operations / (double)total_operations),
+		       meta_operations / elapsed_secs);
+	}
+
+	if (copy_operations) {
+		printf("  Copy (copy/clone) operations: %lu (%.1f%%, %.2f/sec)\n",
+		       copy_operations,
+		       100.0 * ((double)copy_operations / (double)total_operations),
+		       copy_operations / elapsed_secs);
+	}
+
 	printf("\n");
 
 	printf("  Read operations: %lu (%.1f%% total, %.1f%% read/write, %.2f/sec)\n",
@@ -75,6 +179,49 @@ static void verbose_print_results(const struct benchmark_results *results,
 	       100.0 * ((double)results->delete_operations / (double)dir_operations),
 	       results->delete_operations / elapsed_secs);
 
+	if (meta_operations) {
+		printf("  Rename operations: %lu (%.1f%% total, %.1f%% metadata, %.2f/sec)\n",
+		       results->rename_operations,
+		       100.0 * ((double)results->rename_operations / (double)total_operations),
+		       100.0 * ((double)results->rename_operations / (double)meta_operations),
+		       results->rename_operations / elapsed_secs);
+
+		printf("  Link operations: %lu (%.1f%% total, %.1f%% metadata, %.2f/sec)\n",
+		       results->link_operations,
+		       100.0 * ((double)results->link_operations / (double)total_operations),
+		       100.0 * ((double)results->link_operations / (double)meta_operations),
+		       results->link_operations / elapsed_secs);
+
+		printf("  Stat operations: %lu (%.1f%% total, %.1f%% metadata, %.2f/sec)\n",
+		       results->stat_operations,
+		       100.0 * ((double)results->stat_operations / (double)total_operations),
+		       100.0 * ((double)results->stat_operations / (double)meta_operations),
+		       results->stat_operations / elapsed_secs);
+
+		printf("  Readdir operations: %lu (%.1f%% total, %.1f%% metadata, %.2f/sec, %lu entries)\n",
+		       results->readdir_operations,
+		       100.0 * ((double)results->readdir_operations / (double)total_operations),
+		       100.0 * ((double)results->readdir_operations / (double)meta_operations),
+		       results->readdir_operations / elapsed_secs,
+		       results->readdir_entries);
+	}
+
+	if (copy_operations) {
+		printf("  Copy operations: %lu (%.1f%% total, %.1f%% copy/clone, %.2f/sec, %lu fell back to read/write)\n",
+		       results->copy_operations,
+		       100.0 * ((double)results->copy_operations / (double)total_operations),
+		       100.0 * ((double)results->copy_operations / (double)copy_operations),
+		       results->copy_operations / elapsed_secs,
+		       results->copy_fallbacks);
+
+		printf("  Clone operations: %lu (%.1f%% total, %.1f%% copy/clone, %.2f/sec, %lu fell back to copy)\n",
+		       results->clone_operations,
+		       100.0 * ((double)results->clone_operations / (double)total_operations),
+		       100.0 * ((double)results->clone_operations / (double)copy_operations),
+		       results->clone_operations / elapsed_secs,
+		       results->clone_fallbacks);
+	}
+
 	printf("\n");
 
 	printf("  Read ");
@@ -88,6 +235,75 @@ static void verbose_print_results(const struct benchmark_results *results,
 	printf(" (");
 	print_human_readable_bytes(results->bytes_written / elapsed_secs, 2);
 	printf("/s)\n");
+
+	if (results->bytes_copied) {
+		printf("  Copied ");
+		print_human_readable_bytes(results->bytes_copied, 2);
+		printf(" (");
+		print_human_readable_bytes(results->bytes_copied / elapsed_secs,
+					   2);
+		printf("/s)\n");
+	}
+
+	if (results->bytes_cloned) {
+		printf("  Cloned ");
+		print_human_readable_bytes(results->bytes_cloned, 2);
+		printf(" (");
+		print_human_readable_bytes(results->bytes_cloned / elapsed_secs,
+					   2);
+		printf("/s)\n");
+	}
+
+	print_syscalls("Read", results->read_syscalls, results->bytes_read);
+	print_syscalls("Write", results->write_syscalls,
+		       results->bytes_written);
+	if (results->nowait_retries) {
+		printf("  Retried without nowait: %lu times\n",
+		       results->nowait_retries);
+	}
+
+	print_sizes("Initial file", &results->initial_file_sizes);
+	print_sizes("File", &results->file_sizes);
+	print_sizes("Write", &results->write_sizes);
+
+	printf("\n");
+
+	for (int i = 0; i < NUM_OPS; i++)
+		print_latency(operation_labels[i], &results->latency[i]);
+
+	if (results->hot_appends || results->hot_updates) {
+		printf("\n");
+
+		printf("  Hot file appends: %lu, in-place updates: %lu\n",
+		       results->hot_appends, results->hot_updates);
+		if (results->lock_wait.count) {
+			printf("  Lock wait time: %.6f sec (%.2f%% of hot file writes)\n",
+			       results->lock_wait.sum / 1000000000.0,
+			       100.0 * results->lock_wait.sum /
+			       (results->lock_wait.sum +
+				results->hot_io_latency.sum));
+		}
+		print_latency("Hot file lock wait", &results->lock_wait);
+		print_latency("Hot file I/O", &results->hot_io_latency);
+	}
+
+	if (verify) {
+		printf("\n");
+
+		printf("  Verified ");
+		print_human_readable_bytes(results->bytes_verified, 2);
+		printf(" (%lu mismatches)\n", results->verify_errors);
+
+		/*
+		 * Checksum time is summed over the threads, so compare it to
+		 * their summed rather than average elapsed time.
+		 */
+		printf("  Checksum time: %.6f sec (%.2f%% of elapsed, %s CRC32C)\n",
+		       results->checksum_nsecs / 1000000000.0,
+		       100.0 * (results->checksum_nsecs / 1000000000.0) /
+		       elapsed_seconds(&results->elapsed_time),
+		       crc32c_impl());
+	}
 }
 
 static void verbose_thread(int i)
@@ -129,7 +345,7 @@ static void verbose_total(const struct benchmark_results *results)
 
 static void terse_report(const struct benchmark_results *results)
 {
-	printf("%lld.%.9ld\t%lu\t%lu\t%lu\t%lu\t%zu\t%zu\n",
+	printf("%lld.%.9ld\t%lu\t%lu\t%lu\t%lu\t%zu\t%zu\t%lu\t%lu\t%lu\t%lu",
 	       (long long)results->elapsed_time.tv_sec,
 	       results->elapsed_time.tv_nsec,
 	       results->read_operations,
@@ -137,13 +353,116 @@ static void terse_report(const struct benchmark_results *results)
 	       results->create_operations,
 	       results->delete_operations,
 	       results->bytes_read,
-	       results->bytes_written);
+	       results->bytes_written,
+	       results->rename_operations,
+	       results->link_operations,
+	       results->stat_operations,
+	       results->readdir_operations);
+	if (verify) {
+		printf("\t%zu\t%lu\t%.9f", results->bytes_verified,
+		       results->verify_errors,
+		       results->checksum_nsecs / 1000000000.0);
+	}
+	if (copy_ratio > 0.0 || clone_ratio > 0.0) {
+		printf("\t%lu\t%lu\t%zu\t%zu", results->copy_operations,
+		       results->clone_operations, results->bytes_copied,
+		       results->bytes_cloned);
+	}
+	if (hot_files) {
+		printf("\t%lu\t%lu\t%.9f\t%.9f", results->hot_appends,
+		       results->hot_updates,
+		       results->lock_wait.sum / 1000000000.0,
+		       results->hot_io_latency.sum / 1000000000.0);
+	}
+	printf("\n");
 }
 
-static void final_report(bool verbose)
+static void add_results(struct benchmark_results *dst,
+			const struct benchmark_results *src)
 {
-	struct benchmark_results total_results = {};
+	dst->read_operations += src->read_operations;
+	dst->write_operations += src->write_operations;
+	dst->create_operations += src->create_operations;
+	dst->delete_operations += src->delete_operations;
+	dst->rename_operations += src->rename_operations;
+	dst->link_operations += src->link_operations;
+	dst->stat_operations += src->stat_operations;
+	dst->readdir_operations += src->readdir_operations;
+	dst->copy_operations += src->copy_operations;
+	dst->clone_operations += src->clone_operations;
+	dst->readdir_entries += src->readdir_entries;
+	histogram_merge(&dst->file_sizes, &src->file_sizes);
+	histogram_merge(&dst->write_sizes, &src->write_sizes);
+	histogram_merge(&dst->initial_file_sizes, &src->initial_file_sizes);
+	dst->hot_appends += src->hot_appends;
+	dst->hot_updates += src->hot_updates;
+	histogram_merge(&dst->lock_wait, &src->lock_wait);
+	histogram_merge(&dst->hot_io_latency, &src->hot_io_latency);
+	for (int j = 0; j < NUM_OPS; j++)
+		histogram_merge(&dst->latency[j], &src->latency[j]);
+
+	dst->bytes_read += src->bytes_read;
+	dst->bytes_written += src->bytes_written;
+	dst->read_syscalls += src->read_syscalls;
+	dst->write_syscalls += src->write_syscalls;
+	dst->nowait_retries += src->nowait_retries;
+	dst->bytes_copied += src->bytes_copied;
+	dst->bytes_cloned += src->bytes_cloned;
+	dst->copy_fallbacks += src->copy_fallbacks;
+	dst->clone_fallbacks += src->clone_fallbacks;
 
+	dst->bytes_verified += src->bytes_verified;
+	dst->verify_errors += src->verify_errors;
+	dst->checksum_nsecs += src->checksum_nsecs;
+
+	dst->elapsed_time.tv_sec += src->elapsed_time.tv_sec;
+	dst->elapsed_time.tv_nsec += src->elapsed_time.tv_nsec;
+	if (dst->elapsed_time.tv_nsec >= 1000000000L) {
+		dst->elapsed_time.tv_nsec -= 1000000000L;
+		dst->elapsed_time.tv_sec++;
+	}
+}
+
+static void total_report(struct benchmark_results *total_results)
+{
+	for (int i = 0; i < num_threads; i++)
+		add_results(total_results, &threads[i].results);
+}
+
+/*
+ * Add up the results for each target. Every thread spends its whole run on
+ * all of the targets, so the rates are based on the same elapsed time as the
+ * total.
+ */
+static void target_report(struct benchmark_results *target_results,
+			  const struct benchmark_results *total_results)
+{
+	for (unsigned int t = 0; t < num_targets; t++) {
+		memset(&target_results[t], 0, sizeof(target_results[t]));
+		for (int i = 0; i < num_threads; i++)
+			add_results(&target_results[t],
+				    &threads[i].target_results[t]);
+		target_results[t].elapsed_time = total_results->elapsed_time;
+	}
+}
+
+static void verbose_target(unsigned int t,
+			   const struct benchmark_results *results)
+{
+	double elapsed_secs;
+
+	elapsed_secs = (results->elapsed_time.tv_sec +
+			results->elapsed_time.tv_nsec / 1000000000.0);
+
+	printf("\nTarget %u (%s):\n", t, targets[t].path);
+	printf("\n");
+	verbose_print_results(results, elapsed_secs / num_threads);
+}
+
+static void final_report(bool verbose,
+			 const struct benchmark_results *total_results,
+			 const struct benchmark_results *target_results)
+{
 	for (int i = 0; i < num_threads; i++) {
 		if (verbose) {
 			if (i > 0)
@@ -152,27 +471,732 @@ static void final_report(bool verbose)
 		} else {
 			terse_report(&threads[i].results);
 		}
+	}
 
-		total_results.read_operations += threads[i].results.read_operations;
-		total_results.write_operations += threads[i].results.write_operations;
-		total_results.create_operations += threads[i].results.create_operations;
-		total_results.delete_operations += threads[i].results.delete_operations;
-
-		total_results.bytes_read += threads[i].results.bytes_read;
-		total_results.bytes_written += threads[i].results.bytes_written;
-
-		total_results.elapsed_time.tv_sec +=
-			threads[i].results.elapsed_time.tv_sec;
-		total_results.elapsed_time.tv_nsec +=
-			threads[i].results.elapsed_time.tv_nsec;
-		if (total_results.elapsed_time.tv_nsec >= 1000000000L) {
-			total_results.elapsed_time.tv_nsec -= 1000000000L;
-			total_results.elapsed_time.tv_sec++;
+	if (verbose && num_threads > 1)
+		verbose_total(total_results);
+
+	for (unsigned int t = 0; target_results && t < num_targets; t++) {
+		if (verbose) {
+			verbose_target(t, &target_results[t]);
+		} else {
+			printf("target\t%u\t", t);
+			terse_report(&target_results[t]);
 		}
 	}
+}
 
-	if (verbose && num_threads > 1)
-		verbose_total(&total_results);
+static void verbose_cleanup(const struct cleanup_results *results,
+			    double elapsed_secs)
+{
+	printf("  Unlink operations: %lu (%.2f/sec)\n",
+	       results->unlink_operations,
+	       results->unlink_operations / elapsed_secs);
+	if (results->rmdir_operations)
+		printf("  Rmdir operations: %lu\n", results->rmdir_operations);
+	print_latency("Unlink/rmdir", &results->latency);
+}
+
+static void terse_cleanup(const struct cleanup_results *results)
+{
+	printf("cleanup\t%lld.%.9ld\t%lu\t%lu\n",
+	       (long long)results->elapsed_time.tv_sec,
+	       results->elapsed_time.tv_nsec,
+	       results->unlink_operations,
+	       results->rmdir_operations);
+}
+
+static void total_cleanup(struct cleanup_results *total_results)
+{
+	for (int i = 0; i < num_threads; i++) {
+		const struct cleanup_results *results;
+
+		results = &threads[i].cleanup_results;
+		total_results->unlink_operations += results->unlink_operations;
+		total_results->rmdir_operations += results->rmdir_operations;
+		histogram_merge(&total_results->latency, &results->latency);
+
+		/* The phase lasts as long as the slowest thread. */
+		if (results->elapsed_time.tv_sec > total_results->elapsed_time.tv_sec ||
+		    (results->elapsed_time.tv_sec == total_results->elapsed_time.tv_sec &&
+		     results->elapsed_time.tv_nsec > total_results->elapsed_time.tv_nsec))
+			total_results->elapsed_time = results->elapsed_time;
+	}
+}
+
+static void cleanup_report(bool verbose,
+			   const struct cleanup_results *total_results)
+{
+	double elapsed_secs;
+
+	if (!verbose) {
+		for (int i = 0; i < num_threads; i++)
+			terse_cleanup(&threads[i].cleanup_results);
+		return;
+	}
+
+	elapsed_secs = (total_results->elapsed_time.tv_sec +
+			total_results->elapsed_time.tv_nsec / 1000000000.0);
+
+	printf("\nCleanup:\n");
+	printf("  Elapsed time: %.9f sec\n", elapsed_secs);
+	printf("\n");
+	verbose_cleanup(total_results, elapsed_secs);
+}
+
+static void print_summary(const char *name, const struct trial_summary *summary,
+			  double scale, const char *unit)
+{
+	const struct sample_stats *stats = &summary->stats;
+
+	if (stats->n == 0)
+		return;
+
+	printf("  %s: mean %.2f%s, stddev %.2f%s, min %.2f%s, max %.2f%s",
+	       name, stats->mean / scale, unit, stats->stddev / scale, unit,
+	       stats->min / scale, unit, stats->max / scale, unit);
+	if (stats->n >= 2) {
+		printf(", 95%% CI +/- %.2f%s (%.1f%%)", summary->ci / scale,
+		       unit, 100.0 * summary->ci / stats->mean);
+	}
+	printf("\n");
+}
+
+static void terse_summary(const char *name, const struct trial_summary *summary)
+{
+	const struct sample_stats *stats = &summary->stats;
+
+	if (stats->n == 0)
+		return;
+
+	printf("trials\t%s\t%zu\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n", name,
+	       stats->n, stats->mean, stats->stddev, stats->min, stats->max,
+	       summary->ci);
+}
+
+static void trials_report(bool verbose, const struct benchmark_results *trials,
+			  int num_trials)
+{
+	struct trial_summary summary;
+	char name[64];
+
+	trial_throughput(&summary, trials, num_trials, num_threads);
+	if (verbose) {
+		printf("Trials: %d\n", num_trials);
+		printf("\n");
+		print_summary("Throughput", &summary, 1.0, "/sec");
+		printf("\n");
+	} else {
+		terse_summary("throughput", &summary);
+	}
+
+	for (int i = 0; i < NUM_OPS; i++) {
+		for (int j = 0; j < NUM_TRIAL_PERCENTILES; j++) {
+			trial_latency(&summary, trials, num_trials, i,
+				      trial_percentiles[j]);
+			if (verbose) {
+				snprintf(name, sizeof(name), "%s %s latency",
+					 operation_labels[i],
+					 trial_percentile_names[j]);
+				print_summary(name, &summary, 1000.0, " us");
+			} else {
+				snprintf(name, sizeof(name), "%s_%s_ns",
+					 operation_names[i],
+					 trial_percentile_names[j]);
+				terse_summary(name, &summary);
+			}
+		}
+	}
+}
+
+static void set_state(enum live_state state, int trial)
+{
+	if (live)
+		live_set_state(live, state, trial);
+}
+
+static void remove_live_stats(void)
+{
+	live_unlink(live_name);
+}
+
+static int run_threads(void *(*fn)(void *))
+{
+	for (int i = 0; i < num_threads; i++) {
+		errno = pthread_create(&threads[i].thread, NULL, fn,
+				       &threads[i]);
+		if (errno != 0) {
+			perror("pthread_create");
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < num_threads; i++) {
+		void *retval;
+
+		pthread_join(threads[i].thread, &retval);
+		if (retval) {
+			fprintf(stderr, "%s: thread %d failed\n", progname, i);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int alloc_threads(void)
+{
+	int ret = -1;
+
+	pthread_mutex_lock(&threads_lock);
+	threads = calloc(num_threads, sizeof(threads[0]));
+	if (!threads) {
+		perror("calloc");
+		goto out;
+	}
+	errno = pthread_barrier_init(&barrier, NULL, num_threads);
+	if (errno) {
+		perror("pthread_barrier_init");
+		goto out;
+	}
+
+	for (int i = 0; i < num_threads; i++) {
+		threads[i].buffer = malloc(io_buffer_size());
+		if (!threads[i].buffer) {
+			perror("malloc");
+			goto out;
+		}
+		threads[i].target = i % num_targets;
+		if (num_targets > 1) {
+			threads[i].target_results =
+				calloc(num_targets,
+				       sizeof(threads[i].target_results[0]));
+			if (!threads[i].target_results) {
+				perror("calloc");
+				goto out;
+			}
+		}
+		if (slow_threshold_nsecs) {
+			threads[i].slow_log = calloc(1, sizeof(*threads[i].slow_log));
+			if (!threads[i].slow_log) {
+				perror("calloc");
+				goto out;
+			}
+		}
+	}
+	ret = 0;
+out:
+	pthread_mutex_unlock(&threads_lock);
+	return ret;
+}
+
+static void free_threads(void)
+{
+	pthread_mutex_lock(&threads_lock);
+	for (int i = 0; threads && i < num_threads; i++) {
+		free(threads[i].buffer);
+		free(threads[i].target_results);
+		free(threads[i].slow_log);
+	}
+	free(threads);
+	threads = NULL;
+	pthread_mutex_unlock(&threads_lock);
+}
+
+/* Dump the slow operation log whenever SIGUSR1 arrives. */
+static void *slow_log_signal_thread(void *arg)
+{
+	const sigset_t *set = arg;
+	int sig;
+
+	for (;;) {
+		if (sigwait(set, &sig))
+			continue;
+		pthread_mutex_lock(&threads_lock);
+		if (threads) {
+			slow_log_dump(slow_log_file, threads, num_threads,
+				      "on SIGUSR1");
+		}
+		pthread_mutex_unlock(&threads_lock);
+	}
+	return NULL;
+}
+
+/*
+ * Handle SIGUSR1 in a thread of its own. This must be called before any other
+ * threads are created so that they inherit the blocked signal.
+ */
+static int start_slow_log_signal_thread(void)
+{
+	static sigset_t set;
+	pthread_t thread;
+
+	sigemptyset(&set);
+	sigaddset(&set, SIGUSR1);
+	errno = pthread_sigmask(SIG_BLOCK, &set, NULL);
+	if (errno) {
+		perror("pthread_sigmask");
+		return -1;
+	}
+	errno = pthread_create(&thread, NULL, slow_log_signal_thread, &set);
+	if (errno) {
+		perror("pthread_create");
+		return -1;
+	}
+	pthread_detach(thread);
+	return 0;
+}
+
+/*
+ * Run the benchmark locally up to num_trials times. Returns the number of
+ * trials completed or -1 on error.
+ */
+static int run_trials(long seed, int num_trials, double target_error,
+		      bool fresh_files, bool reuse_files,
+		      struct benchmark_results *trials)
+{
+	int completed_trials = 0;
+
+	while (completed_trials < num_trials) {
+		int trial = completed_trials;
+		struct trial_summary summary;
+		uint32_t file_seed;
+
+		/*
+		 * Unless the workload leaves them alone, every trial starts
+		 * from the same initial files, or from a fresh set with its own
+		 * seed.
+		 */
+		if (trial == 0 || fresh_files || workload_modifies_files()) {
+			if (trial > 0) {
+				set_state(LIVE_CLEANUP, trial);
+				fprintf(stderr, "Removing benchmark files...\n");
+				if (run_threads(run_cleanup))
+					return -1;
+				uninit_benchmark();
+			}
+			set_state(LIVE_CREATING, trial);
+			file_seed = seed - 1 - (fresh_files ? trial : 0);
+			if (init_benchmark_files(threads, num_threads,
+						 file_seed, reuse_files))
+				return -1;
+		}
+
+		reset_benchmark();
+		for (int i = 0; i < num_threads; i++) {
+			threads[i].prng_seed = seed + trial * num_threads + i;
+			memset(&threads[i].results, 0,
+			       sizeof(threads[i].results));
+			memset(&threads[i].cleanup_results, 0,
+			       sizeof(threads[i].cleanup_results));
+			if (threads[i].target_results) {
+				memset(threads[i].target_results, 0,
+				       num_targets *
+				       sizeof(threads[i].target_results[0]));
+			}
+			if (threads[i].slow_log)
+				slow_log_reset(threads[i].slow_log);
+		}
+		add_initial_file_sizes(&threads[0].results);
+
+		set_state(LIVE_RUNNING, trial);
+		if (num_trials > 1)
+			fprintf(stderr, "Running trial %d...\n", trial);
+		else
+			fprintf(stderr, "Running benchmark...\n");
+		if (run_threads(run_benchmark))
+			return -1;
+		if (slow_threshold_nsecs) {
+			char title[64];
+
+			if (num_trials > 1)
+				snprintf(title, sizeof(title), "in trial %d", trial);
+			else
+				snprintf(title, sizeof(title), "in the run");
+			slow_log_dump(slow_log_file, threads, num_threads, title);
+		}
+		total_report(&trials[trial]);
+		completed_trials++;
+
+		if (num_trials == 1)
+			break;
+		fprintf(stderr, "Trial %d: %.2f operations/sec\n", trial,
+			total_operations(&trials[trial]) /
+			(elapsed_seconds(&trials[trial].elapsed_time) / num_threads));
+		trial_throughput(&summary, trials, completed_trials,
+				 num_threads);
+		if (target_error > 0.0 && completed_trials >= 2 &&
+		    summary.ci <= target_error * summary.stats.mean) {
+			fprintf(stderr, "Throughput is within %.2f%% after %d trials\n",
+				100.0 * summary.ci / summary.stats.mean,
+				completed_trials);
+			break;
+		}
+	}
+	return completed_trials;
+}
+
+static void agent_error(int fd, const char *message)
+{
+	remote_send(fd, REMOTE_ERROR, message, strlen(message));
+}
+
+/* Tell the controller that the files are ready, and where they are. */
+static int send_ready(int fd)
+{
+	struct remote_ready *ready;
+	struct run_metadata meta;
+	size_t size;
+	int ret;
+
+	if (collect_metadata(&meta, 0, num_threads))
+		return -1;
+	size = sizeof(*ready) + meta.num_targets * sizeof(meta.targets[0]);
+	ready = calloc(1, size);
+	if (!ready) {
+		perror("calloc");
+		free_metadata(&meta);
+		return -1;
+	}
+	memcpy(ready->hostname, meta.hostname, sizeof(ready->hostname));
+	ready->num_targets = meta.num_targets;
+	memcpy(ready + 1, meta.targets,
+	       meta.num_targets * sizeof(meta.targets[0]));
+	ret = remote_send(fd, REMOTE_READY, ready, size);
+	free(ready);
+	free_metadata(&meta);
+	return ret;
+}
+
+/*
+ * Run the benchmark once for a controller: take the parameters and seed from
+ * it, create the initial files, and run when it says to start.
+ */
+static int agent_session(int fd)
+{
+	const struct remote_setup *setup;
+	enum remote_message_type type;
+	size_t length, results_size;
+	char *results, *p;
+	void *start = NULL;
+	void *msg;
+	FILE *config;
+	int ret = -1;
+
+	msg = remote_recv(fd, &type, &length);
+	if (!msg)
+		return -1;
+	setup = msg;
+	if (type != REMOTE_SETUP || length < sizeof(*setup) ||
+	    setup->version != REMOTE_VERSION ||
+	    setup->results_size != sizeof(struct benchmark_results) ||
+	    setup->cleanup_results_size != sizeof(struct cleanup_results) ||
+	    setup->num_threads == 0) {
+		fprintf(stderr, "%s: incompatible controller\n", progname);
+		agent_error(fd, "incompatible agent");
+		free(msg);
+		return -1;
+	}
+
+	config = fmemopen((char *)(setup + 1), length - sizeof(*setup), "r");
+	if (!config) {
+		perror("fmemopen");
+		agent_error(fd, "invalid parameters");
+		free(msg);
+		return -1;
+	}
+	if (parse_params_file(config, "<controller>") || check_params()) {
+		agent_error(fd, "invalid parameters");
+		fclose(config);
+		free(msg);
+		return -1;
+	}
+	fclose(config);
+
+	num_threads = setup->num_threads;
+	if (alloc_threads()) {
+		agent_error(fd, "out of memory");
+		goto out;
+	}
+	if (init_benchmark_files(threads, num_threads, setup->seed - 1,
+				 setup->flags & REMOTE_REUSE)) {
+		agent_error(fd, "creating initial files failed");
+		goto out_files;
+	}
+	reset_benchmark();
+	for (int i = 0; i < num_threads; i++)
+		threads[i].prng_seed = setup->seed + setup->first_thread + i;
+	add_initial_file_sizes(&threads[0].results);
+
+	if (send_ready(fd))
+		goto out_files;
+	start = remote_recv(fd, &type, &length);
+	if (!start || type != REMOTE_START)
+		goto out_files;
+
+	fprintf(stderr, "Running benchmark...\n");
+	if (run_threads(run_benchmark)) {
+		agent_error(fd, "benchmark failed");
+		goto out_files;
+	}
+	if (slow_threshold_nsecs)
+		slow_log_dump(slow_log_file, threads, num_threads, "in the run");
+	if (setup->flags & REMOTE_CLEANUP) {
+		fprintf(stderr, "Cleaning up benchmark files...\n");
+		if (run_threads(run_cleanup)) {
+			agent_error(fd, "cleanup failed");
+			goto out_files;
+		}
+	}
+
+	/* Each thread's benchmark results, then each thread's cleanup results. */
+	results_size = num_threads * (sizeof(threads[0].results) +
+				       sizeof(threads[0].cleanup_results));
+	results = malloc(results_size);
+	if (!results) {
+		perror("malloc");
+		agent_error(fd, "out of memory");
+		goto out_files;
+	}
+	p = results;
+	for (int i = 0; i < num_threads; i++) {
+		memcpy(p, &threads[i].results, sizeof(threads[i].results));
+		p += sizeof(threads[i].results);
+	}
+	for (int i = 0; i < num_threads; i++) {
+		memcpy(p, &threads[i].cleanup_results,
+		       sizeof(threads[i].cleanup_results));
+		p += sizeof(threads[i].cleanup_results);
+	}
+	ret = remote_send(fd, REMOTE_RESULTS, results, results_size);
+	free(results);
+
+out_files:
+	uninit_benchmark();
+	pthread_barrier_destroy(&barrier);
+out:
+	free_threads();
+	free(start);
+	free(msg);
+	return ret;
+}
+
+/*
+ * Serve controllers one at a time until killed. Targets stay open between
+ * runs, and a failed run doesn't stop the agent.
+ */
+static int run_agent(const char *port)
+{
+	int listen_fd;
+
+	listen_fd = remote_listen(port);
+	if (listen_fd == -1)
+		return -1;
+	fprintf(stderr, "Listening on port %s...\n", port);
+
+	for (;;) {
+		char peer[300];
+		int fd;
+
+		fd = remote_accept(listen_fd, peer, sizeof(peer));
+		if (fd == -1)
+			return -1;
+		fprintf(stderr, "Controller %s connected\n", peer);
+		if (agent_session(fd))
+			fprintf(stderr, "Run for %s failed\n", peer);
+		else
+			fprintf(stderr, "Run for %s finished\n", peer);
+		close(fd);
+	}
+}
+
+static void write_param(const char *key, enum param_type type,
+			const char *value, void *arg)
+{
+	fprintf(arg, "%s %s\n", key, value);
+}
+
+static void *expect_message(int fd, const char *address,
+			    enum remote_message_type expected,
+			    size_t *length)
+{
+	enum remote_message_type type;
+	void *payload;
+
+	payload = remote_recv(fd, &type, length);
+	if (!payload) {
+		fprintf(stderr, "%s: agent %s failed\n", progname, address);
+		return NULL;
+	}
+	if (type == REMOTE_ERROR) {
+		fprintf(stderr, "%s: agent %s: %s\n", progname, address,
+			(char *)payload);
+		free(payload);
+		return NULL;
+	}
+	if (type != expected) {
+		fprintf(stderr, "%s: agent %s sent an unexpected message\n",
+			progname, address);
+		free(payload);
+		return NULL;
+	}
+	return payload;
+}
+
+/*
+ * Run the benchmark on agents instead of locally. Every agent runs
+ * agent_threads threads, which become threads of this run in the order of the
+ * agents, and all of them start once every agent has created its files.
+ */
+static int run_controller(char **addresses, int num_agents, int agent_threads,
+			  long seed, bool reuse_files, bool cleanup,
+			  struct run_metadata *meta)
+{
+	struct remote_setup *setup = NULL;
+	size_t config_size, setup_size, length;
+	size_t results_size;
+	char *config = NULL;
+	FILE *stream;
+	int *fds;
+	int ret = -1;
+
+	fds = malloc(num_agents * sizeof(fds[0]));
+	meta->agents = calloc(num_agents, sizeof(meta->agents[0]));
+	if (!fds || !meta->agents) {
+		perror("malloc");
+		free(fds);
+		return -1;
+	}
+	meta->num_agents = num_agents;
+	for (int i = 0; i < num_agents; i++)
+		fds[i] = -1;
+
+	stream = open_memstream(&config, &config_size);
+	if (!stream) {
+		perror("open_memstream");
+		goto out;
+	}
+	for_each_param(write_param, stream);
+	if (fclose(stream)) {
+		perror("fclose");
+		goto out;
+	}
+	setup_size = sizeof(*setup) + config_size;
+	setup = malloc(setup_size);
+	if (!setup) {
+		perror("malloc");
+		goto out;
+	}
+	memcpy(setup + 1, config, config_size);
+
+	for (int i = 0; i < num_agents; i++) {
+		struct agent_info *agent = &meta->agents[i];
+
+		snprintf(agent->address, sizeof(agent->address), "%s",
+			 addresses[i]);
+		agent->first_thread = i * agent_threads;
+		agent->num_threads = agent_threads;
+
+		fds[i] = remote_connect(addresses[i]);
+		if (fds[i] == -1)
+			goto out;
+
+		setup->version = REMOTE_VERSION;
+		setup->results_size = sizeof(struct benchmark_results);
+		setup->cleanup_results_size = sizeof(struct cleanup_results);
+		setup->flags = ((cleanup ? REMOTE_CLEANUP : 0) |
+				(reuse_files ? REMOTE_REUSE : 0));
+		setup->seed = seed;
+		setup->num_threads = agent_threads;
+		setup->first_thread = agent->first_thread;
+		if (remote_send(fds[i], REMOTE_SETUP, setup, setup_size))
+			goto out;
+	}
+
+	fprintf(stderr, "Waiting for %d agents to create their files...\n",
+		num_agents);
+	for (int i = 0; i < num_agents; i++) {
+		struct agent_info *agent = &meta->agents[i];
+		struct remote_ready *ready;
+		size_t targets_size;
+
+		ready = expect_message(fds[i], addresses[i], REMOTE_READY,
+				       &length);
+		if (!ready)
+			goto out;
+		targets_size = length - sizeof(*ready);
+		if (length < sizeof(*ready) ||
+		    targets_size != ready->num_targets *
+				    sizeof(agent->targets[0])) {
+			fprintf(stderr, "%s: agent %s sent an invalid ready message\n",
+				progname, addresses[i]);
+			free(ready);
+			goto out;
+		}
+		ready->hostname[sizeof(ready->hostname) - 1] = '\0';
+		memcpy(agent->hostname, ready->hostname,
+		       sizeof(agent->hostname));
+		agent->targets = malloc(targets_size ? targets_size : 1);
+		if (!agent->targets) {
+			perror("malloc");
+			free(ready);
+			goto out;
+		}
+		memcpy(agent->targets, ready + 1, targets_size);
+		agent->num_targets = ready->num_targets;
+		free(ready);
+	}
+
+	/* Every agent is ready, so this is the barrier. */
+	fprintf(stderr, "Running benchmark...\n");
+	for (int i = 0; i < num_agents; i++) {
+		if (remote_send(fds[i], REMOTE_START, NULL, 0))
+			goto out;
+	}
+
+	results_size = agent_threads * (sizeof(threads[0].results) +
+					sizeof(threads[0].cleanup_results));
+	for (int i = 0; i < num_agents; i++) {
+		struct benchmark_thread *base;
+		char *results, *p;
+
+		results = expect_message(fds[i], addresses[i], REMOTE_RESULTS,
+					 &length);
+		if (!results)
+			goto out;
+		if (length != results_size) {
+			fprintf(stderr, "%s: agent %s sent invalid results\n",
+				progname, addresses[i]);
+			free(results);
+			goto out;
+		}
+		base = &threads[meta->agents[i].first_thread];
+		p = results;
+		for (int j = 0; j < agent_threads; j++) {
+			memcpy(&base[j].results, p,
+			       sizeof(base[j].results));
+			p += sizeof(base[j].results);
+		}
+		for (int j = 0; j < agent_threads; j++) {
+			memcpy(&base[j].cleanup_results, p,
+			       sizeof(base[j].cleanup_results));
+			p += sizeof(base[j].cleanup_results);
+		}
+		free(results);
+		fprintf(stderr, "Agent %s (%s) finished\n", addresses[i],
+			meta->agents[i].hostname);
+	}
+	ret = 0;
+
+out:
+	for (int i = 0; i < num_agents; i++) {
+		if (fds[i] != -1)
+			close(fds[i]);
+	}
+	free(fds);
+	free(setup);
+	free(config);
+	return ret;
 }
 
 #define OPTS EXTRA_OPTS
@@ -188,13 +1212,40 @@ static void usage(bool error)
 		"\n"
 		"Configuration:\n"
 		"  -C DIR       Change directories before running\n"
+		"  -D DIR       Place files in DIR; repeat to stripe across several\n"
+		"               directories (default: the current directory)\n"
 		"  -c CONFIG    Benchmark configuration file\n"
 		"  -p THREADS   Run multiple threads in parallel\n"
+		"  -r           Reuse initial files from a previous run\n"
 		"  -s SEED      PRNG seed value\n"
+		"  -u           Remove all files after the benchmark\n"
+		"\n"
+		"Repeated trials:\n"
+		"  -n TRIALS    Run the benchmark several times and summarize the results\n"
+		"  -E PERCENT   Stop once the throughput confidence interval is within\n"
+		"               PERCENT of the mean\n"
+		"  -F           Create a fresh set of initial files for each trial\n"
 		"\n"
 		"Output:\n"
-		"  -t           Terse, parseable output\n"
-		"  -v           Verbose, human-readable output (default)\n"
+		"  -f FORMAT    Output format: verbose, terse, json, or csv\n"
+		"  -t           Terse, parseable output (-f terse)\n"
+		"  -v           Verbose, human-readable output (-f verbose, default)\n"
+		"  -S NAME      Publish live statistics in shared memory segment NAME\n"
+		"               (see omark-top)\n"
+		"  -L USECS     Log operations taking at least USECS microseconds and\n"
+		"               dump the log after the run or on SIGUSR1\n"
+		"  -l FILE      Write the slow operation log to FILE (default stderr)\n"
+		"\n"
+		"Multiple nodes:\n"
+		"  -A PORT      Run as an agent which runs the benchmark for\n"
+		"               controllers connecting to PORT\n"
+		"  -N ADDRESS   Run the benchmark on the agent at HOST[:PORT] instead of\n"
+		"               locally; repeat for several agents, each running\n"
+		"               THREADS threads (default port " REMOTE_DEFAULT_PORT ")\n"
+		"\n"
+		"Regression detection:\n"
+		"  -b BASELINE  Compare results to a JSON report from a previous run\n"
+		"  -T PERCENT   Smallest change counted as a regression (default 5)\n"
 		"\n"
 		"Miscellaneous:\n"
 		"  -d           Dump benchmark configuration and exit\n"
@@ -213,13 +1264,42 @@ int main(int argc, char *argv[])
 	char *chdir_path = NULL;
 	char *config_path = NULL;
 	long seed = 0xdeadbeefL;
+	char *baseline_path = NULL;
+	double tolerance = 0.05;
 	bool dump_params_flag = false;
-	bool verbose = true;
+	enum output_format format = FORMAT_VERBOSE;
+	struct benchmark_results *trials, *total_results;
+	struct benchmark_results *target_results = NULL;
+	struct run_results run;
+	char **target_paths = NULL;
+	int num_target_paths = 0;
+	char *agent_port = NULL;
+	char **agent_addresses = NULL;
+	int num_agents = 0, agent_threads = 0;
+	struct cleanup_results cleanup_results = {};
+	struct run_metadata meta;
+	int num_trials = 1, completed_trials = 0;
+	double target_error = 0.0;
+	double slow_threshold;
+	int regressions = 0;
+	bool reuse_files = false;
+	bool fresh_files = false;
+	bool cleanup = false;
 
 	progname = argv[0];
 
-	while ((opt = getopt(argc, argv, "C:c:dp:s:tvh")) != -1) {
+	while ((opt = getopt(argc, argv, "A:b:C:c:D:dE:Ff:L:l:N:n:p:rS:s:T:tuvh")) != -1) {
 		switch (opt) {
+		case 'A':
+			agent_port = optarg;
+			break;
+		case 'b':
+			baseline_path = strdup(optarg);
+			if (!baseline_path) {
+				perror("strdup");
+				return EXIT_FAILURE;
+			}
+			break;
 		case 'C':
 			chdir_path = strdup(optarg);
 			if (!chdir_path) {
@@ -234,9 +1314,86 @@ int main(int argc, char *argv[])
 				return EXIT_FAILURE;
 			}
 			break;
+		case 'D':
+			target_paths = realloc(target_paths,
+					       (num_target_paths + 1) *
+					       sizeof(target_paths[0]));
+			if (!target_paths) {
+				perror("realloc");
+				return EXIT_FAILURE;
+			}
+			target_paths[num_target_paths++] = optarg;
+			break;
 		case 'd':
 			dump_params_flag = true;
 			break;
+		case 'E':
+			target_error = strtod(optarg, &end) / 100.0;
+			if (*end != '\0' || target_error <= 0.0) {
+				fprintf(stderr, "%s: invalid relative error\n",
+					progname);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'F':
+			fresh_files = true;
+			break;
+		case 'f':
+			for (format = 0; format < NUM_FORMATS; format++) {
+				if (strcmp(optarg, format_names[format]) == 0)
+					break;
+			}
+			if (format == NUM_FORMATS) {
+				fprintf(stderr, "%s: invalid output format\n",
+					progname);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'L':
+			slow_threshold = strtod(optarg, &end);
+			if (*end != '\0' || !(slow_threshold > 0.0)) {
+				fprintf(stderr, "%s: invalid slow operation threshold\n",
+					progname);
+				return EXIT_FAILURE;
+			}
+			/* Round up so that tiny thresholds don't turn logging off. */
+			slow_threshold_nsecs = ceil(slow_threshold * 1000.0);
+			break;
+		case 'l':
+			slow_log_file = fopen(optarg, "w");
+			if (!slow_log_file) {
+				perror(optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'N':
+			agent_addresses = realloc(agent_addresses,
+						  (num_agents + 1) *
+						  sizeof(agent_addresses[0]));
+			if (!agent_addresses) {
+				perror("realloc");
+				return EXIT_FAILURE;
+			}
+			agent_addresses[num_agents++] = optarg;
+			break;
+		case 'n':
+			num_trials = strtol(optarg, &end, 10);
+			if (num_trials <= 0 || *end != '\0') {
+				fprintf(stderr, "%s: invalid number of trials\n",
+					progname);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'r':
+			reuse_files = true;
+			break;
+		case 'S':
+			live_name = strdup(optarg);
+			if (!live_name) {
+				perror("strdup");
+				return EXIT_FAILURE;
+			}
+			break;
 		case 's':
 			seed = strtol(optarg, &end, 0);
 			if (*end != '\0') {
@@ -253,11 +1410,22 @@ int main(int argc, char *argv[])
 				return EXIT_FAILURE;
 			}
 			break;
+		case 'T':
+			tolerance = strtod(optarg, &end) / 100.0;
+			if (*end != '\0' || tolerance < 0.0) {
+				fprintf(stderr, "%s: invalid tolerance\n",
+					progname);
+				return EXIT_FAILURE;
+			}
+			break;
 		case 't':
-			verbose = false;
+			format = FORMAT_TERSE;
+			break;
+		case 'u':
+			cleanup = true;
 			break;
 		case 'v':
-			verbose = true;
+			format = FORMAT_VERBOSE;
 			break;
 		case 'h':
 			usage(false);
@@ -273,6 +1441,9 @@ int main(int argc, char *argv[])
 		free(config_path);
 	}
 
+	if (check_params())
+		return EXIT_FAILURE;
+
 	if (dump_params_flag) {
 		dump_params();
 		return EXIT_SUCCESS;
@@ -287,56 +1458,153 @@ int main(int argc, char *argv[])
 		free(chdir_path);
 	}
 
-	threads = calloc(num_threads, sizeof(threads[0]));
-	if (!threads) {
-		perror("calloc");
+	/* The agents run in their own targets, so a controller has none. */
+	if (agent_addresses && num_target_paths) {
+		fprintf(stderr, "%s: -D is an agent option with -N\n",
+			progname);
 		return EXIT_FAILURE;
 	}
-	errno = pthread_barrier_init(&barrier, NULL, num_threads);
-	if (errno) {
-		perror("pthread_barrier_init");
+	for (int i = 0; i < num_target_paths; i++) {
+		if (add_target(target_paths[i]))
+			return EXIT_FAILURE;
+	}
+	if (num_target_paths == 0 && !agent_addresses && add_target("."))
 		return EXIT_FAILURE;
+	free(target_paths);
+
+	crc32c_init();
+
+	if (slow_threshold_nsecs) {
+		if (agent_addresses) {
+			fprintf(stderr, "%s: -L is an agent option with -N\n",
+				progname);
+			return EXIT_FAILURE;
+		}
+		if (!slow_log_file)
+			slow_log_file = stderr;
+		if (start_slow_log_signal_thread())
+			return EXIT_FAILURE;
 	}
 
-	for (int i = 0; i < num_threads; i++) {
-		threads[i].prng_seed = seed + i;
-		threads[i].buffer = malloc(block_size);
-		if (!threads[i].buffer) {
-			perror("malloc");
+	if (agent_port)
+		return run_agent(agent_port) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	if (agent_addresses) {
+		if (num_trials > 1 || live_name) {
+			fprintf(stderr, "%s: -n and -S are not supported with agents\n",
+				progname);
 			return EXIT_FAILURE;
 		}
+		agent_threads = num_threads;
+		num_threads *= num_agents;
 	}
 
-	fprintf(stderr, "Creating initial benchmark files...\n");
-	ret = init_benchmark_files(seed - 1);
-	if (ret)
+	if (collect_metadata(&meta, seed, num_threads))
 		return EXIT_FAILURE;
 
-	fprintf(stderr, "Running benchmark...\n");
-	for (int i = 0; i < num_threads; i++) {
-		errno = pthread_create(&threads[i].thread, NULL, run_benchmark,
-				       &threads[i]);
-		if (errno != 0) {
-			perror("pthread_create");
+	trials = calloc(num_trials, sizeof(trials[0]));
+	if (!trials) {
+		perror("calloc");
+		return EXIT_FAILURE;
+	}
+
+	if (agent_addresses) {
+		threads = calloc(num_threads, sizeof(threads[0]));
+		if (!threads) {
+			perror("calloc");
 			return EXIT_FAILURE;
 		}
-	}
+		if (run_controller(agent_addresses, num_agents, agent_threads,
+				   seed, reuse_files, cleanup, &meta))
+			return EXIT_FAILURE;
+		free(agent_addresses);
+		total_report(&trials[0]);
+		completed_trials = 1;
+	} else {
+		if (alloc_threads())
+			return EXIT_FAILURE;
 
-	for (int i = 0; i < num_threads; i++) {
-		void *retval;
+		if (live_name) {
+			live = live_create(live_name, num_threads, num_trials);
+			if (!live)
+				return EXIT_FAILURE;
+			atexit(remove_live_stats);
+			for (int i = 0; i < num_threads; i++)
+				threads[i].live = &live->slots[i];
+		}
 
-		pthread_join(threads[i].thread, &retval);
-		if (retval) {
-			fprintf(stderr, "%s: thread %d failed\n", progname, i);
+		if (num_targets > 1) {
+			target_results = calloc(num_targets,
+						sizeof(target_results[0]));
+			if (!target_results) {
+				perror("calloc");
+				return EXIT_FAILURE;
+			}
+		}
+
+		completed_trials = run_trials(seed, num_trials, target_error,
+					      fresh_files, reuse_files, trials);
+		if (completed_trials == -1)
 			return EXIT_FAILURE;
+
+		if (cleanup) {
+			set_state(LIVE_CLEANUP, completed_trials - 1);
+			fprintf(stderr, "Cleaning up benchmark files...\n");
+			if (run_threads(run_cleanup))
+				return EXIT_FAILURE;
 		}
 	}
+	total_results = &trials[completed_trials - 1];
+	if (target_results)
+		target_report(target_results, total_results);
+	if (cleanup)
+		total_cleanup(&cleanup_results);
+	set_state(LIVE_DONE, completed_trials - 1);
 
-	final_report(verbose);
+	run.meta = &meta;
+	run.threads = threads;
+	run.total = total_results;
+	run.trials = trials;
+	run.num_trials = completed_trials;
+	run.targets = target_results;
+	run.cleanup = cleanup ? &cleanup_results : NULL;
 
-	for (int i = 0; i < num_threads; i++)
-		free(threads[i].buffer);
-	free(threads);
+	switch (format) {
+	case FORMAT_VERBOSE:
+	case FORMAT_TERSE:
+		if (completed_trials > 1)
+			trials_report(format == FORMAT_VERBOSE, trials,
+				      completed_trials);
+		else
+			final_report(format == FORMAT_VERBOSE, total_results,
+				     target_results);
+		if (cleanup)
+			cleanup_report(format == FORMAT_VERBOSE, &cleanup_results);
+		break;
+	case FORMAT_JSON:
+		json_report(stdout, &run);
+		break;
+	case FORMAT_CSV:
+		csv_report(stdout, &run);
+		break;
+	case NUM_FORMATS:
+		break;
+	}
+	fflush(stdout);
+
+	if (baseline_path) {
+		regressions = compare_to_baseline(baseline_path, tolerance,
+						  &run);
+		if (regressions == -1)
+			return EXIT_FAILURE;
+		free(baseline_path);
+	}
+
+	free_threads();
+	free(trials);
+	free(target_results);
+	free_metadata(&meta);
 	uninit_benchmark();
-	return EXIT_SUCCESS;
+	/* Distinguish regressions from failures. */
+	return regressions ? 2 : EXIT_SUCCESS;
 }
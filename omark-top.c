@@ -0,0 +1,229 @@
+/*
+ * Live viewer for the statistics an omark run publishes with -S.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "live.h"
+
+static const char *progname;
+
+static const char * const state_names[] = {
+	[LIVE_STARTING] = "starting",
+	[LIVE_CREATING] = "creating files",
+	[LIVE_RUNNING] = "running",
+	[LIVE_CLEANUP] = "removing files",
+	[LIVE_DONE] = "done",
+};
+
+#define MB (1024.0 * 1024.0)
+
+static uint64_t total_operations(const struct live_slot *slot)
+{
+	uint64_t total = 0;
+
+	for (int i = 0; i < NUM_OPS; i++)
+		total += slot->operations[i];
+	return total;
+}
+
+/*
+ * Add the values recorded between two snapshots of a histogram to another
+ * histogram. The minimum isn't known, so percentiles are only bounded by the
+ * maximum.
+ */
+static void histogram_delta(struct histogram *dst, const struct histogram *cur,
+			    const struct histogram *prev)
+{
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		uint64_t delta = cur->buckets[i] - prev->buckets[i];
+
+		dst->buckets[i] += delta;
+		dst->count += delta;
+	}
+	dst->sum += cur->sum - prev->sum;
+	dst->min = 0;
+	if (cur->max > dst->max)
+		dst->max = cur->max;
+}
+
+static void display(const struct live_stats *live, struct live_slot *cur,
+		    struct live_slot *prev, bool clear)
+{
+	int num_threads = live->header.num_threads;
+	uint32_t state = __atomic_load_n(&live->header.state, __ATOMIC_ACQUIRE);
+	uint32_t trial = __atomic_load_n(&live->header.trial, __ATOMIC_RELAXED);
+	struct histogram interval[NUM_OPS];
+	double op_rates[NUM_OPS] = {};
+	double total_rate = 0.0, total_read = 0.0, total_written = 0.0;
+	uint64_t total_ops = 0;
+
+	memset(interval, 0, sizeof(interval));
+
+	if (clear)
+		printf("\033[H\033[J");
+	printf("omark pid %ld: %s", (long)live->header.pid,
+	       state < sizeof(state_names) / sizeof(state_names[0]) ?
+	       state_names[state] : "unknown");
+	if (live->header.num_trials > 1)
+		printf(", trial %u/%u", trial + 1, live->header.num_trials);
+	printf(", %d thread%s\n\n", num_threads, num_threads == 1 ? "" : "s");
+
+	printf("Thread   Operations      Ops/sec   Read MB/s  Write MB/s\n");
+	for (int i = 0; i < num_threads; i++) {
+		double secs, rate = 0.0, read = 0.0, written = 0.0;
+
+		secs = (cur[i].elapsed_nsecs - prev[i].elapsed_nsecs) / 1000000000.0;
+		if (secs > 0.0) {
+			rate = (total_operations(&cur[i]) -
+				total_operations(&prev[i])) / secs;
+			read = (cur[i].bytes_read - prev[i].bytes_read) / secs;
+			written = (cur[i].bytes_written -
+				   prev[i].bytes_written) / secs;
+			for (int j = 0; j < NUM_OPS; j++) {
+				op_rates[j] += (cur[i].operations[j] -
+						prev[i].operations[j]) / secs;
+			}
+		}
+		for (int j = 0; j < NUM_OPS; j++) {
+			histogram_delta(&interval[j], &cur[i].latency[j],
+					&prev[i].latency[j]);
+		}
+
+		printf("%6d %12llu %12.2f %11.2f %11.2f\n", i,
+		       (unsigned long long)total_operations(&cur[i]), rate,
+		       read / MB, written / MB);
+		total_ops += total_operations(&cur[i]);
+		total_rate += rate;
+		total_read += read;
+		total_written += written;
+	}
+	printf(" Total %12llu %12.2f %11.2f %11.2f\n\n",
+	       (unsigned long long)total_ops, total_rate, total_read / MB,
+	       total_written / MB);
+
+	printf("Operation      Ops/sec   p50 (us)   p99 (us) p99.9 (us)\n");
+	for (int i = 0; i < NUM_OPS; i++) {
+		if (interval[i].count == 0 && op_rates[i] == 0.0)
+			continue;
+		printf("%-9s %12.2f %10.2f %10.2f %10.2f\n",
+		       operation_names[i], op_rates[i],
+		       histogram_percentile(&interval[i], 50.0) / 1000.0,
+		       histogram_percentile(&interval[i], 99.0) / 1000.0,
+		       histogram_percentile(&interval[i], 99.9) / 1000.0);
+	}
+	fflush(stdout);
+}
+
+static void usage(bool error)
+{
+	FILE *file = error ? stderr : stdout;
+
+	fprintf(file,
+		"Usage: %s [OPTIONS] NAME\n"
+		"\n"
+		"Show the live statistics of an omark run started with -S NAME.\n"
+		"Rates and latencies are over the last interval.\n"
+		"\n"
+		"  -i SECONDS   Refresh interval (default 1)\n"
+		"  -n COUNT     Exit after COUNT refreshes\n"
+		"  -h           Display this help message and exit\n",
+		progname);
+
+	exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+int main(int argc, char *argv[])
+{
+	const struct live_stats *live;
+	struct live_slot *cur, *prev;
+	double interval_secs = 1.0;
+	struct timespec interval;
+	long count = -1;
+	int num_threads;
+	size_t size;
+	bool clear;
+	char *end;
+	int opt;
+
+	progname = argv[0];
+
+	while ((opt = getopt(argc, argv, "i:n:h")) != -1) {
+		switch (opt) {
+		case 'i':
+			interval_secs = strtod(optarg, &end);
+			if (*end != '\0' || interval_secs <= 0.0) {
+				fprintf(stderr, "%s: invalid interval\n",
+					progname);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'n':
+			count = strtol(optarg, &end, 10);
+			if (*end != '\0' || count <= 0) {
+				fprintf(stderr, "%s: invalid count\n",
+					progname);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'h':
+			usage(false);
+		default:
+			usage(true);
+		}
+	}
+	if (optind != argc - 1)
+		usage(true);
+
+	live = live_attach(argv[optind], &size);
+	if (!live)
+		return EXIT_FAILURE;
+
+	num_threads = live->header.num_threads;
+	cur = calloc(num_threads, sizeof(cur[0]));
+	prev = calloc(num_threads, sizeof(prev[0]));
+	if (!cur || !prev) {
+		perror("calloc");
+		return EXIT_FAILURE;
+	}
+	interval.tv_sec = interval_secs;
+	interval.tv_nsec = (interval_secs - interval.tv_sec) * 1000000000.0;
+	clear = isatty(STDOUT_FILENO);
+
+	for (;;) {
+		uint32_t state;
+
+		state = __atomic_load_n(&live->header.state, __ATOMIC_ACQUIRE);
+		for (int i = 0; i < num_threads; i++) {
+			if (live_read(&live->slots[i], &cur[i]) == -1)
+				cur[i] = prev[i];
+			/* A new trial starts over from zero. */
+			if (cur[i].elapsed_nsecs < prev[i].elapsed_nsecs)
+				memset(&prev[i], 0, sizeof(prev[i]));
+		}
+
+		display(live, cur, prev, clear);
+		if (state == LIVE_DONE || --count == 0)
+			break;
+		if (kill(live->header.pid, 0) == -1 && errno == ESRCH) {
+			fprintf(stderr, "%s: omark process %ld exited\n",
+				progname, (long)live->header.pid);
+			return EXIT_FAILURE;
+		}
+
+		memcpy(prev, cur, num_threads * sizeof(cur[0]));
+		nanosleep(&interval, NULL);
+		if (!clear)
+			printf("\n");
+	}
+
+	free(cur);
+	free(prev);
+	return EXIT_SUCCESS;
+}
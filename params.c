@@ -1,6 +1,10 @@
+/* For F_OFD_SETLKW. */
+#define _GNU_SOURCE
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "benchmark.h"
 #include "params.h"
 
 size_t block_size = 512;
@@ -10,33 +14,201 @@ size_t min_file_size = 1024;
 size_t max_file_size = 100 * 1024;
 size_t min_write_size = 512;
 size_t max_write_size = 10 * 1024;
+struct size_distribution file_size_distribution;
+struct size_distribution write_size_distribution;
 double io_dir_ratio = 0.90;
 double read_write_ratio = 0.50;
 double create_delete_ratio = 0.8;
+double metadata_ratio = 0.0;
+double namespace_lookup_ratio = 0.5;
+double rename_link_ratio = 0.5;
+double stat_readdir_ratio = 0.9;
+bool maildir = false;
 unsigned long max_operations = 10000;
 unsigned long time_limit = 0;
+bool verify = false;
+bool preallocate = false;
+double copy_ratio = 0.0;
+double clone_ratio = 0.0;
+unsigned long hot_files = 0;
+double hot_file_ratio = 1.0;
+double hot_append_update_ratio = 0.5;
+enum hot_lock hot_lock = HOT_LOCK_NONE;
+enum target_policy target_policy = TARGET_ROUND_ROBIN;
+enum io_mode io_mode = IO_BLOCK;
+unsigned int rw_flags = 0;
+enum namespace_mode namespace_mode = NAMESPACE_SHARED;
+
+const char * const io_mode_names[] = {
+	[IO_BLOCK] = "block",
+	[IO_VECTORED] = "vectored",
+};
+
+const char * const rw_flag_names[NUM_RW_FLAGS] = {
+	"nowait",
+	"dsync",
+	"sync",
+	"hipri",
+};
+
+const char * const namespace_mode_names[] = {
+	[NAMESPACE_SHARED] = "shared",
+	[NAMESPACE_PARTITIONED] = "partitioned",
+};
+
+const char * const hot_lock_names[] = {
+	[HOT_LOCK_NONE] = "none",
+	[HOT_LOCK_FLOCK] = "flock",
+	[HOT_LOCK_FCNTL] = "fcntl",
+};
+
+const char * const target_policy_names[] = {
+	[TARGET_ROUND_ROBIN] = "round-robin",
+	[TARGET_HASH] = "hash",
+	[TARGET_PER_THREAD] = "per-thread",
+};
+
+/*
+ * Maildir mail store: messages are delivered into tmp/ and renamed into new/,
+ * then renamed into cur/ and have their flags changed by the IMAP server, while
+ * clients constantly stat them and scan the directories. Messages are never
+ * appended to.
+ */
+static void preset_maildir(void)
+{
+	maildir = true;
+	io_dir_ratio = 0.7;
+	read_write_ratio = 1.0;
+	create_delete_ratio = 0.5;
+	metadata_ratio = 0.5;
+	namespace_lookup_ratio = 0.3;
+	rename_link_ratio = 0.95;
+	stat_readdir_ratio = 0.9;
+}
+
+static int parse_target_policy(const char *name)
+{
+	for (int i = 0; i <= TARGET_PER_THREAD; i++) {
+		if (strcmp(name, target_policy_names[i]) == 0) {
+			target_policy = i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static int parse_io_mode(const char *name)
+{
+	for (int i = 0; i <= IO_VECTORED; i++) {
+		if (strcmp(name, io_mode_names[i]) == 0) {
+			io_mode = i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static int parse_namespace_mode(const char *name)
+{
+	for (int i = 0; i <= NAMESPACE_PARTITIONED; i++) {
+		if (strcmp(name, namespace_mode_names[i]) == 0) {
+			namespace_mode = i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static int parse_hot_lock(const char *name)
+{
+	for (int i = 0; i <= HOT_LOCK_FCNTL; i++) {
+		if (strcmp(name, hot_lock_names[i]) == 0) {
+			hot_lock = i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* Parse "none" or a comma-separated list of flags. */
+static int parse_rw_flags(char *list)
+{
+	unsigned int flags = 0;
+	char *saveptr, *name;
+
+	if (strcmp(list, "none") == 0) {
+		rw_flags = 0;
+		return 0;
+	}
+	for (name = strtok_r(list, ",", &saveptr); name;
+	     name = strtok_r(NULL, ",", &saveptr)) {
+		int i;
+
+		for (i = 0; i < NUM_RW_FLAGS; i++) {
+			if (strcmp(name, rw_flag_names[i]) == 0)
+				break;
+		}
+		if (i == NUM_RW_FLAGS)
+			return -1;
+		flags |= 1 << i;
+	}
+	if (!flags)
+		return -1;
+	rw_flags = flags;
+	return 0;
+}
+
+static void format_rw_flags(char *buf, size_t size)
+{
+	size_t len = 0;
+
+	snprintf(buf, size, "none");
+	for (int i = 0; i < NUM_RW_FLAGS; i++) {
+		if (!(rw_flags & (1 << i)))
+			continue;
+		len += snprintf(buf + len, size - len, "%s%s", len ? "," : "",
+				rw_flag_names[i]);
+	}
+}
+
+static int apply_preset(const char *name)
+{
+	if (strcmp(name, "maildir") == 0) {
+		preset_maildir();
+		return 0;
+	}
+	return -1;
+}
 
 int parse_params(const char *config_path)
 {
 	FILE *file;
+	int status;
+
+	if (strcmp(config_path, "-") == 0)
+		return parse_params_file(stdin, "<stdin>");
+
+	file = fopen(config_path, "r");
+	if (!file) {
+		perror("fopen");
+		return -1;
+	}
+	status = parse_params_file(file, config_path);
+	fclose(file);
+	return status;
+}
+
+int parse_params_file(FILE *file, const char *name)
+{
 	char *line = NULL;
 	size_t n = 0;
 	int lineno = 1;
 	ssize_t ret;
 	int status = 0;
 
-	if (strcmp(config_path, "-") == 0) {
-		file = stdin;
-	} else {
-		file = fopen(config_path, "r");
-		if (!file) {
-			perror("fopen");
-			return -1;
-		}
-	}
-
 	while ((ret = getline(&line, &n, file)) >= 0) {
 		bool success = false;
+		char preset[32], policy[32], mode[32], flags[64];
 
 #define PARSE_PARAM(format, ptr) do {				\
 	if (!success)						\
@@ -51,13 +223,19 @@ int parse_params(const char *config_path)
 				*ptr = true;			\
 				success = true;			\
 			} else if (strcmp(buf, "false") == 0) {	\
-				*ptr = true;			\
+				*ptr = false;			\
 				success = true;			\
 			}					\
 		}						\
 	}							\
 } while (0)
 
+		if (sscanf(line, "preset %31s", preset) == 1)
+			success = apply_preset(preset) == 0;
+		if (!success && strncmp(line, "file-size-distribution ", 23) == 0)
+			success = parse_distribution(&file_size_distribution, line + 23);
+		if (!success && strncmp(line, "write-size-distribution ", 24) == 0)
+			success = parse_distribution(&write_size_distribution, line + 24);
 		PARSE_PARAM("block-size %zu\n", &block_size);
 		PARSE_BOOL("block-aligned", &block_aligned);
 		PARSE_PARAM("initial-files %lu", &initial_files);
@@ -68,13 +246,35 @@ int parse_params(const char *config_path)
 		PARSE_PARAM("io-dir-ratio %lf", &io_dir_ratio);
 		PARSE_PARAM("read-write-ratio %lf", &read_write_ratio);
 		PARSE_PARAM("create-delete-ratio %lf", &create_delete_ratio);
+		PARSE_PARAM("metadata-ratio %lf", &metadata_ratio);
+		PARSE_PARAM("namespace-lookup-ratio %lf", &namespace_lookup_ratio);
+		PARSE_PARAM("rename-link-ratio %lf", &rename_link_ratio);
+		PARSE_PARAM("stat-readdir-ratio %lf", &stat_readdir_ratio);
+		PARSE_BOOL("maildir", &maildir);
 		PARSE_PARAM("max-operations %lu", &max_operations);
 		PARSE_PARAM("time-limit %lu", &time_limit);
+		PARSE_BOOL("verify", &verify);
+		PARSE_BOOL("preallocate", &preallocate);
+		PARSE_PARAM("copy-ratio %lf", &copy_ratio);
+		PARSE_PARAM("clone-ratio %lf", &clone_ratio);
+		PARSE_PARAM("hot-files %lu", &hot_files);
+		PARSE_PARAM("hot-file-ratio %lf", &hot_file_ratio);
+		PARSE_PARAM("hot-append-update-ratio %lf",
+			    &hot_append_update_ratio);
+		if (!success && sscanf(line, "target-policy %31s", policy) == 1)
+			success = parse_target_policy(policy) == 0;
+		if (!success && sscanf(line, "io-mode %31s", mode) == 1)
+			success = parse_io_mode(mode) == 0;
+		if (!success && sscanf(line, "rw-flags %63s", flags) == 1)
+			success = parse_rw_flags(flags) == 0;
+		if (!success && sscanf(line, "namespace %31s", mode) == 1)
+			success = parse_namespace_mode(mode) == 0;
+		if (!success && sscanf(line, "hot-lock %31s", mode) == 1)
+			success = parse_hot_lock(mode) == 0;
 
 		if (!success) {
 			fprintf(stderr, "%s:%d: invalid configuration: %s",
-				file == stdin ? "<stdin>" : config_path,
-				lineno, line);
+				name, lineno, line);
 			status = -1;
 			break;
 		}
@@ -91,24 +291,166 @@ int parse_params(const char *config_path)
 	}
 
 	free(line);
-	if (file != stdin)
-		fclose(file);
-
 	return status;
 }
 
+int check_params(void)
+{
+	if (block_size == 0) {
+		fprintf(stderr, "block-size must be positive\n");
+		return -1;
+	}
+	if (verify && block_size < 2 * VERIFY_HEADER_SIZE) {
+		fprintf(stderr, "block-size must be at least %d with verify\n",
+			2 * VERIFY_HEADER_SIZE);
+		return -1;
+	}
+#ifndef __linux__
+	if (rw_flags) {
+		fprintf(stderr, "rw-flags are only supported on Linux\n");
+		return -1;
+	}
+	if (preallocate) {
+		fprintf(stderr, "preallocate is only supported on Linux\n");
+		return -1;
+	}
+#endif
+#ifndef F_OFD_SETLKW
+	/* Classic fcntl locks wouldn't exclude threads of the same process. */
+	if (hot_lock == HOT_LOCK_FCNTL) {
+		fprintf(stderr, "hot-lock fcntl needs open file description locks\n");
+		return -1;
+	}
+#endif
+	if (copy_ratio < 0.0 || clone_ratio < 0.0 ||
+	    copy_ratio + clone_ratio > 1.0) {
+		fprintf(stderr, "copy-ratio and clone-ratio must add up to at most 1\n");
+		return -1;
+	}
+	if (hot_file_ratio < 0.0 || hot_file_ratio > 1.0) {
+		fprintf(stderr, "hot-file-ratio must be between 0 and 1\n");
+		return -1;
+	}
+	if (hot_append_update_ratio < 0.0 || hot_append_update_ratio > 1.0) {
+		fprintf(stderr, "hot-append-update-ratio must be between 0 and 1\n");
+		return -1;
+	}
+	if (distribution_init(&file_size_distribution, min_file_size,
+			      max_file_size) == -1) {
+		fprintf(stderr, "invalid file-size-distribution\n");
+		return -1;
+	}
+	if (distribution_init(&write_size_distribution, min_write_size,
+			      max_write_size) == -1) {
+		fprintf(stderr, "invalid write-size-distribution\n");
+		return -1;
+	}
+	return 0;
+}
+
+void for_each_param(void (*fn)(const char *key, enum param_type type,
+			       const char *value, void *arg),
+		    void *arg)
+{
+	char value[PARAM_VALUE_MAX];
+
+#define INTEGER_PARAM(key, var) do {				\
+	snprintf(value, sizeof(value), "%llu", (unsigned long long)var);	\
+	fn(key, PARAM_INTEGER, value, arg);			\
+} while (0)
+
+#define REAL_PARAM(key, var) do {				\
+	snprintf(value, sizeof(value), "%.17g", var);		\
+	fn(key, PARAM_REAL, value, arg);			\
+} while (0)
+
+#define BOOLEAN_PARAM(key, var)					\
+	fn(key, PARAM_BOOLEAN, var ? "true" : "false", arg)
+
+#define DISTRIBUTION_PARAM(key, var) do {			\
+	describe_distribution(&var, value, sizeof(value));	\
+	fn(key, PARAM_STRING, value, arg);			\
+} while (0)
+
+	INTEGER_PARAM("block-size", block_size);
+	BOOLEAN_PARAM("block-aligned", block_aligned);
+	INTEGER_PARAM("initial-files", initial_files);
+	INTEGER_PARAM("min-file-size", min_file_size);
+	INTEGER_PARAM("max-file-size", max_file_size);
+	DISTRIBUTION_PARAM("file-size-distribution", file_size_distribution);
+	INTEGER_PARAM("min-write-size", min_write_size);
+	INTEGER_PARAM("max-write-size", max_write_size);
+	DISTRIBUTION_PARAM("write-size-distribution", write_size_distribution);
+	REAL_PARAM("io-dir-ratio", io_dir_ratio);
+	REAL_PARAM("read-write-ratio", read_write_ratio);
+	REAL_PARAM("create-delete-ratio", create_delete_ratio);
+	REAL_PARAM("metadata-ratio", metadata_ratio);
+	REAL_PARAM("namespace-lookup-ratio", namespace_lookup_ratio);
+	REAL_PARAM("rename-link-ratio", rename_link_ratio);
+	REAL_PARAM("stat-readdir-ratio", stat_readdir_ratio);
+	BOOLEAN_PARAM("maildir", maildir);
+	INTEGER_PARAM("max-operations", max_operations);
+	INTEGER_PARAM("time-limit", time_limit);
+	BOOLEAN_PARAM("verify", verify);
+	BOOLEAN_PARAM("preallocate", preallocate);
+	REAL_PARAM("copy-ratio", copy_ratio);
+	REAL_PARAM("clone-ratio", clone_ratio);
+	INTEGER_PARAM("hot-files", hot_files);
+	REAL_PARAM("hot-file-ratio", hot_file_ratio);
+	REAL_PARAM("hot-append-update-ratio", hot_append_update_ratio);
+	fn("hot-lock", PARAM_STRING, hot_lock_names[hot_lock], arg);
+	fn("target-policy", PARAM_STRING, target_policy_names[target_policy],
+	   arg);
+	fn("io-mode", PARAM_STRING, io_mode_names[io_mode], arg);
+	format_rw_flags(value, sizeof(value));
+	fn("rw-flags", PARAM_STRING, value, arg);
+	fn("namespace", PARAM_STRING, namespace_mode_names[namespace_mode],
+	   arg);
+
+#undef INTEGER_PARAM
+#undef REAL_PARAM
+#undef BOOLEAN_PARAM
+#undef DISTRIBUTION_PARAM
+}
+
 void dump_params(void)
 {
+	char dist[PARAM_VALUE_MAX];
+
 	fprintf(stderr, "Benchmark parameters:\n");
 	fprintf(stderr, "  block size=%zu\n", block_size);
 	fprintf(stderr, "  block aligned=%s\n", block_aligned ? "true" : "false");
 	fprintf(stderr, "  initial files=%ld\n", initial_files);
 	fprintf(stderr, "  file size=%zu-%zu\n", min_file_size, max_file_size);
+	describe_distribution(&file_size_distribution, dist, sizeof(dist));
+	fprintf(stderr, "  file size distribution=%s\n", dist);
 	fprintf(stderr, "  write size=%zu-%zu\n", min_write_size, max_write_size);
+	describe_distribution(&write_size_distribution, dist, sizeof(dist));
+	fprintf(stderr, "  write size distribution=%s\n", dist);
 	fprintf(stderr, "  I/O operation/directory operation ratio=%f\n",
 		io_dir_ratio);
 	fprintf(stderr, "  read/write ratio=%f\n", read_write_ratio);
 	fprintf(stderr, "  create/delete ratio=%f\n", create_delete_ratio);
+	fprintf(stderr, "  metadata operation ratio=%f\n", metadata_ratio);
+	fprintf(stderr, "  namespace/lookup ratio=%f\n", namespace_lookup_ratio);
+	fprintf(stderr, "  rename/link ratio=%f\n", rename_link_ratio);
+	fprintf(stderr, "  stat/readdir ratio=%f\n", stat_readdir_ratio);
+	fprintf(stderr, "  maildir=%s\n", maildir ? "true" : "false");
 	fprintf(stderr, "  max operations=%ld\n", max_operations);
 	fprintf(stderr, "  time limit=%ld\n", time_limit);
+	fprintf(stderr, "  verify=%s\n", verify ? "true" : "false");
+	fprintf(stderr, "  preallocate=%s\n", preallocate ? "true" : "false");
+	fprintf(stderr, "  copy ratio=%f\n", copy_ratio);
+	fprintf(stderr, "  clone ratio=%f\n", clone_ratio);
+	fprintf(stderr, "  hot files=%lu\n", hot_files);
+	fprintf(stderr, "  hot file ratio=%f\n", hot_file_ratio);
+	fprintf(stderr, "  hot append/update ratio=%f\n",
+		hot_append_update_ratio);
+	fprintf(stderr, "  hot lock=%s\n", hot_lock_names[hot_lock]);
+	fprintf(stderr, "  target policy=%s\n",
+		target_policy_names[target_policy]);
+	fprintf(stderr, "  I/O mode=%s\n", io_mode_names[io_mode]);
+	format_rw_flags(dist, sizeof(dist));
+	fprintf(stderr, "  read/write flags=%s\n", dist);
+	fprintf(stderr, "  namespace=%s\n", namespace_mode_names[namespace_mode]);
 }
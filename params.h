@@ -6,6 +6,8 @@
 #define PARAMS_H
 
 #include <stdbool.h>
+#include <stdio.h>
+#include "distribution.h"
 
 /* I/O block size. */
 extern size_t block_size;
@@ -17,16 +19,104 @@ extern unsigned long initial_files;
 extern size_t min_file_size, max_file_size;
 /* Minimum/maximum file write operation sizes. */
 extern size_t min_write_size, max_write_size;
+/* Distributions of initial file sizes and write sizes. */
+extern struct size_distribution file_size_distribution;
+extern struct size_distribution write_size_distribution;
 /* Ratio of I/O (read/write) to directory (create/delete) operations. */
 extern double io_dir_ratio;
 /* Ratio of reads to writes. */
 extern double read_write_ratio;
 /* Ratio of creates to deletes. */
 extern double create_delete_ratio;
+/* Fraction of operations which are metadata (rename/link/stat/readdir). */
+extern double metadata_ratio;
+/* Ratio of namespace (rename/link) to lookup (stat/readdir) operations. */
+extern double namespace_lookup_ratio;
+/* Ratio of renames to links. */
+extern double rename_link_ratio;
+/* Ratio of stats to readdirs. */
+extern double stat_readdir_ratio;
+/* Lay files out as a maildir (tmp/, new/, and cur/)? */
+extern bool maildir;
 /* Maximum number of operations (0 means no limit). */
 extern unsigned long max_operations;
 /* Maximum number of seconds to run (0 means no limit). */
 extern unsigned long time_limit;
+/* Write self-describing, checksummed blocks and verify them on read? */
+extern bool verify;
+/* Allocate the size of new files before writing them? */
+extern bool preallocate;
+/* Fractions of all operations which copy or clone a file. */
+extern double copy_ratio;
+extern double clone_ratio;
+/* Number of hot files shared by all threads (0 means none). */
+extern unsigned long hot_files;
+/* Fraction of writes which go to a hot file. */
+extern double hot_file_ratio;
+/* Ratio of appends to in-place updates of hot files. */
+extern double hot_append_update_ratio;
+
+enum target_policy {
+	TARGET_ROUND_ROBIN,
+	TARGET_HASH,
+	TARGET_PER_THREAD,
+};
+
+enum io_mode {
+	IO_BLOCK,
+	IO_VECTORED,
+};
+
+/* How file data is submitted: one system call per block or per operation. */
+extern enum io_mode io_mode;
+/* Names of the I/O modes, as in the configuration file. */
+extern const char * const io_mode_names[];
+
+enum rw_flag {
+	RW_NOWAIT = 1 << 0,
+	RW_DSYNC = 1 << 1,
+	RW_SYNC = 1 << 2,
+	RW_HIPRI = 1 << 3,
+};
+
+#define NUM_RW_FLAGS 4
+
+/*
+ * Flags (enum rw_flag) to pass to preadv2() and pwritev2(), or 0 to use the
+ * plain system calls.
+ */
+extern unsigned int rw_flags;
+/* Names of the flags, as in the configuration file. */
+extern const char * const rw_flag_names[NUM_RW_FLAGS];
+
+enum namespace_mode {
+	NAMESPACE_SHARED,
+	NAMESPACE_PARTITIONED,
+};
+
+/*
+ * Whether all threads work on one set of files, or each thread on its own in
+ * a private subdirectory.
+ */
+extern enum namespace_mode namespace_mode;
+/* Names of the namespace modes, as in the configuration file. */
+extern const char * const namespace_mode_names[];
+
+enum hot_lock {
+	HOT_LOCK_NONE,
+	HOT_LOCK_FLOCK,
+	HOT_LOCK_FCNTL,
+};
+
+/* Advisory lock taken around writes to hot files. */
+extern enum hot_lock hot_lock;
+/* Names of the lock types, as in the configuration file. */
+extern const char * const hot_lock_names[];
+
+/* How new files are assigned to target directories. */
+extern enum target_policy target_policy;
+/* Names of the policies, as in the configuration file. */
+extern const char * const target_policy_names[];
 
 /**
  * parse_params - parse a configuration file and update the benchmark parameters
@@ -35,6 +125,40 @@ extern unsigned long time_limit;
  */
 int parse_params(const char *config_path);
 
+/**
+ * parse_params_file - parse configuration from an open file and update the
+ * benchmark parameters accordingly
+ * @file: file to read configuration from
+ * @name: name of the file for error messages
+ */
+int parse_params_file(FILE *file, const char *name);
+
+/**
+ * check_params - check that the benchmark parameters are consistent and
+ * prepare the size distributions
+ */
+int check_params(void);
+
+enum param_type {
+	PARAM_INTEGER,
+	PARAM_REAL,
+	PARAM_BOOLEAN,
+	PARAM_STRING,
+};
+
+/* Maximum length of a formatted parameter value. */
+#define PARAM_VALUE_MAX 1100
+
+/**
+ * for_each_param - call a function for every benchmark parameter
+ * @fn: function to call with the parameter's configuration file key, type,
+ * and value formatted as it would be in a configuration file
+ * @arg: argument to pass to the function
+ */
+void for_each_param(void (*fn)(const char *key, enum param_type type,
+			       const char *value, void *arg),
+		    void *arg);
+
 /**
  * dump_params - dump the benchmark parameters in a human-readable format
  */
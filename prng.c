@@ -48,6 +48,11 @@ static uint32_t mt_word(struct prng *prng)
 	return y;
 }
 
+uint32_t prng_u32(struct prng *prng)
+{
+	return mt_word(prng);
+}
+
 uint32_t prng_range(struct prng *prng, uint32_t low, uint32_t high)
 {
 	/* Not actually perfectly uniform... Oh well. */
@@ -22,6 +22,12 @@ struct prng {
  */
 void prng_init(struct prng *prng, uint32_t seed);
 
+/**
+ * prng_u32 - generate a random 32-bit number
+ * @prng: the PRNG
+ */
+uint32_t prng_u32(struct prng *prng);
+
 /**
  * prng_range - generate a random number in a uniformly distributed range
  * @prng: the PRNG
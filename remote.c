@@ -0,0 +1,263 @@
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include "remote.h"
+
+/* Largest payload accepted, to catch garbage on the connection. */
+#define REMOTE_MAX_LENGTH (UINT64_C(1) << 32)
+
+static void set_nodelay(int fd)
+{
+	int one = 1;
+
+	/* Messages are small and latency matters for the start message. */
+	if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == -1)
+		perror("setsockopt");
+}
+
+int remote_listen(const char *port)
+{
+	struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+		.ai_flags = AI_PASSIVE,
+	};
+	struct addrinfo *res, *ai;
+	int fd = -1, one = 1;
+	int ret;
+
+	ret = getaddrinfo(NULL, port, &hints, &res);
+	if (ret) {
+		fprintf(stderr, "%s: %s\n", port, gai_strerror(ret));
+		return -1;
+	}
+
+	/* Prefer IPv6, which also accepts IPv4 connections on Linux. */
+	for (int pass = 0; pass < 2 && fd == -1; pass++) {
+		for (ai = res; ai; ai = ai->ai_next) {
+			if ((ai->ai_family == AF_INET6) != (pass == 0))
+				continue;
+			fd = socket(ai->ai_family, ai->ai_socktype,
+				    ai->ai_protocol);
+			if (fd == -1)
+				continue;
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one,
+				   sizeof(one));
+			if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+			    listen(fd, 16) == 0)
+				break;
+			close(fd);
+			fd = -1;
+		}
+	}
+	if (fd == -1)
+		perror("bind");
+
+	freeaddrinfo(res);
+	return fd;
+}
+
+int remote_accept(int listen_fd, char *peer, size_t size)
+{
+	struct sockaddr_storage addr;
+	socklen_t addrlen = sizeof(addr);
+	char host[256], serv[32];
+	int fd;
+
+	do {
+		fd = accept(listen_fd, (struct sockaddr *)&addr, &addrlen);
+	} while (fd == -1 && (errno == EINTR || errno == ECONNABORTED));
+	if (fd == -1) {
+		perror("accept");
+		return -1;
+	}
+	set_nodelay(fd);
+
+	if (getnameinfo((struct sockaddr *)&addr, addrlen, host, sizeof(host),
+			serv, sizeof(serv), NI_NUMERICHOST | NI_NUMERICSERV))
+		snprintf(peer, size, "unknown");
+	else
+		snprintf(peer, size, "%s:%s", host, serv);
+	return fd;
+}
+
+/*
+ * Split HOST:PORT, [HOST]:PORT, or [HOST] into its host and port. A bare IPv6
+ * address (more than one colon) has no port.
+ */
+static int split_address(const char *address, char *host, size_t size,
+			 const char **port)
+{
+	const char *colon, *end;
+	size_t len;
+
+	*port = REMOTE_DEFAULT_PORT;
+	if (address[0] == '[') {
+		address++;
+		end = strchr(address, ']');
+		if (!end || (end[1] != '\0' && end[1] != ':'))
+			return -1;
+		if (end[1] == ':')
+			*port = end + 2;
+	} else {
+		colon = strchr(address, ':');
+		if (colon && !strchr(colon + 1, ':')) {
+			end = colon;
+			*port = colon + 1;
+		} else {
+			end = address + strlen(address);
+		}
+	}
+
+	len = end - address;
+	if (len == 0 || len >= size || **port == '\0')
+		return -1;
+	memcpy(host, address, len);
+	host[len] = '\0';
+	return 0;
+}
+
+int remote_connect(const char *address)
+{
+	struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+	};
+	struct addrinfo *res, *ai;
+	char host[256];
+	const char *port;
+	int fd = -1;
+	int ret;
+
+	if (split_address(address, host, sizeof(host), &port)) {
+		fprintf(stderr, "%s: invalid agent address\n", address);
+		return -1;
+	}
+
+	ret = getaddrinfo(host, port, &hints, &res);
+	if (ret) {
+		fprintf(stderr, "%s: %s\n", address, gai_strerror(ret));
+		return -1;
+	}
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd == -1)
+			continue;
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		ret = errno;
+		close(fd);
+		fd = -1;
+		errno = ret;
+	}
+	if (fd == -1)
+		perror(address);
+	else
+		set_nodelay(fd);
+
+	freeaddrinfo(res);
+	return fd;
+}
+
+static int send_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len > 0) {
+		ssize_t ret;
+
+		/* A controller or agent going away shouldn't kill us. */
+		ret = send(fd, p, len, MSG_NOSIGNAL);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("send");
+			return -1;
+		}
+		p += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+/* Returns 1 on success, 0 if the peer closed the connection, or -1 on error. */
+static int recv_all(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+
+	while (len > 0) {
+		ssize_t ret;
+
+		ret = recv(fd, p, len, 0);
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+			perror("recv");
+			return -1;
+		}
+		if (ret == 0)
+			return 0;
+		p += ret;
+		len -= ret;
+	}
+	return 1;
+}
+
+int remote_send(int fd, enum remote_message_type type, const void *payload,
+		size_t length)
+{
+	struct remote_header header = {
+		.magic = REMOTE_MAGIC,
+		.type = type,
+		.length = length,
+	};
+
+	if (send_all(fd, &header, sizeof(header)) == -1)
+		return -1;
+	return send_all(fd, payload, length);
+}
+
+void *remote_recv(int fd, enum remote_message_type *type_ret,
+		  size_t *length_ret)
+{
+	struct remote_header header;
+	char *payload;
+	int ret;
+
+	ret = recv_all(fd, &header, sizeof(header));
+	if (ret <= 0) {
+		if (ret == 0)
+			fprintf(stderr, "connection closed\n");
+		return NULL;
+	}
+	if (header.magic != REMOTE_MAGIC || header.length > REMOTE_MAX_LENGTH) {
+		fprintf(stderr, "invalid message\n");
+		return NULL;
+	}
+
+	payload = malloc(header.length + 1);
+	if (!payload) {
+		perror("malloc");
+		return NULL;
+	}
+	ret = recv_all(fd, payload, header.length);
+	if (ret <= 0) {
+		if (ret == 0)
+			fprintf(stderr, "connection closed\n");
+		free(payload);
+		return NULL;
+	}
+	payload[header.length] = '\0';
+
+	*type_ret = header.type;
+	*length_ret = header.length;
+	return payload;
+}
@@ -0,0 +1,122 @@
+/*
+ * Protocol between a controller and the agents which run the benchmark for it,
+ * usually on other machines.
+ *
+ * Every message is a header followed by a payload. The controller connects to
+ * every agent and sends REMOTE_SETUP with the parameters of the run; each
+ * agent creates its initial files and replies with REMOTE_READY, its
+ * hostname, and the filesystems of its targets. Once all of the agents are ready, the controller sends
+ * REMOTE_START to all of them at once, and each one runs the benchmark and
+ * replies with REMOTE_RESULTS. An agent replies with REMOTE_ERROR and a
+ * message instead if anything fails.
+ *
+ * Results are sent as the raw structures, so the controller and the agents
+ * must run the same build on the same architecture. The setup message carries
+ * the structure sizes to catch mismatches.
+ */
+
+#ifndef REMOTE_H
+#define REMOTE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define REMOTE_MAGIC UINT32_C(0x4f4d5250) /* "OMRP" */
+#define REMOTE_VERSION 2
+
+/* Default port that agents listen on. */
+#define REMOTE_DEFAULT_PORT "7478"
+
+enum remote_message_type {
+	REMOTE_SETUP = 1,
+	REMOTE_READY,
+	REMOTE_START,
+	REMOTE_RESULTS,
+	REMOTE_ERROR,
+};
+
+struct remote_header {
+	uint32_t magic;
+	uint32_t type;
+	uint64_t length;
+};
+
+/* Remove the files after the benchmark. */
+#define REMOTE_CLEANUP 0x1
+/* Reuse initial files from a previous run. */
+#define REMOTE_REUSE 0x2
+
+/*
+ * Payload of REMOTE_SETUP, followed by the benchmark parameters in the
+ * configuration file format.
+ */
+struct remote_setup {
+	uint32_t version;
+	/* Sizes of struct benchmark_results and struct cleanup_results. */
+	uint32_t results_size;
+	uint32_t cleanup_results_size;
+	uint32_t flags;
+	int64_t seed;
+	uint32_t num_threads;
+	/* Number of the agent's first thread among all of the threads. */
+	uint32_t first_thread;
+};
+
+/*
+ * Payload of REMOTE_READY, followed by a struct filesystem_info for each of the
+ * agent's targets.
+ */
+struct remote_ready {
+	char hostname[256];
+	uint32_t num_targets;
+};
+
+/**
+ * remote_listen - listen for controllers on a TCP port
+ * @port: port number or service name
+ *
+ * Returns the listening socket or -1 on error.
+ */
+int remote_listen(const char *port);
+
+/**
+ * remote_accept - accept a connection from a controller
+ * @listen_fd: socket returned by remote_listen()
+ * @peer: returned address of the controller
+ * @size: size of @peer
+ *
+ * Returns the connected socket or -1 on error.
+ */
+int remote_accept(int listen_fd, char *peer, size_t size);
+
+/**
+ * remote_connect - connect to an agent
+ * @address: HOST or HOST:PORT
+ *
+ * Returns the connected socket or -1 on error.
+ */
+int remote_connect(const char *address);
+
+/**
+ * remote_send - send a message
+ * @fd: connected socket
+ * @type: type of the message
+ * @payload: payload of the message
+ * @length: length of the payload
+ */
+int remote_send(int fd, enum remote_message_type type, const void *payload,
+		size_t length);
+
+/**
+ * remote_recv - receive a message
+ * @fd: connected socket
+ * @type_ret: returned type of the message
+ * @length_ret: returned length of the payload
+ *
+ * Returns the payload, which must be freed and is followed by a null
+ * terminator, or NULL on error or if the peer closed the connection.
+ */
+void *remote_recv(int fd, enum remote_message_type *type_ret,
+		  size_t *length_ret);
+
+#endif /* REMOTE_H */
@@ -0,0 +1,651 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+#include "json.h"
+#include "params.h"
+#include "report.h"
+
+/* Percentiles included in reports. */
+static const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+static const char * const percentile_names[] = {
+	"p50", "p90", "p99", "p99.9", "p99.99",
+};
+#define NUM_PERCENTILES (sizeof(percentiles) / sizeof(percentiles[0]))
+
+const double trial_percentiles[NUM_TRIAL_PERCENTILES] = {50.0, 99.0, 99.9};
+const char * const trial_percentile_names[NUM_TRIAL_PERCENTILES] = {
+	"p50", "p99", "p99.9",
+};
+
+unsigned long operation_count(const struct benchmark_results *results,
+			      enum operation op)
+{
+	switch (op) {
+	case OP_READ:
+		return results->read_operations;
+	case OP_WRITE:
+		return results->write_operations;
+	case OP_CREATE:
+		return results->create_operations;
+	case OP_DELETE:
+		return results->delete_operations;
+	case OP_RENAME:
+		return results->rename_operations;
+	case OP_LINK:
+		return results->link_operations;
+	case OP_STAT:
+		return results->stat_operations;
+	case OP_READDIR:
+		return results->readdir_operations;
+	case OP_COPY:
+		return results->copy_operations;
+	case OP_CLONE:
+		return results->clone_operations;
+	default:
+		return 0;
+	}
+}
+
+unsigned long total_operations(const struct benchmark_results *results)
+{
+	unsigned long total = 0;
+
+	for (int i = 0; i < NUM_OPS; i++)
+		total += operation_count(results, i);
+	return total;
+}
+
+static void summarize(struct trial_summary *summary, const double *values,
+		      size_t n)
+{
+	sample_stats(&summary->stats, values, n);
+	summary->ci = n >= 2 ? confidence_interval(&summary->stats) : 0.0;
+}
+
+static double trial_rate(const struct benchmark_results *trial,
+			 int num_threads)
+{
+	return (total_operations(trial) /
+		(elapsed_seconds(&trial->elapsed_time) / num_threads));
+}
+
+void trial_throughput(struct trial_summary *summary,
+		      const struct benchmark_results *trials, int num_trials,
+		      int num_threads)
+{
+	double values[num_trials];
+
+	for (int i = 0; i < num_trials; i++)
+		values[i] = trial_rate(&trials[i], num_threads);
+	summarize(summary, values, num_trials);
+}
+
+void trial_latency(struct trial_summary *summary,
+		   const struct benchmark_results *trials, int num_trials,
+		   enum operation op, double percentile)
+{
+	double values[num_trials];
+	size_t n = 0;
+
+	for (int i = 0; i < num_trials; i++) {
+		if (trials[i].latency[op].count) {
+			values[n++] = histogram_percentile(&trials[i].latency[op],
+							   percentile);
+		}
+	}
+	summarize(summary, values, n);
+}
+
+/*
+ * Find the filesystem containing a directory in /proc/self/mountinfo. If
+ * several mounts match (e.g., bind mounts), the one with the longest mount
+ * point containing the directory wins.
+ */
+static void find_filesystem(int dirfd, struct filesystem_info *fs)
+{
+#ifdef __linux__
+	FILE *file;
+	char *line = NULL;
+	size_t n = 0, best = 0;
+	struct stat st;
+
+	if (fstat(dirfd, &st) == -1)
+		return;
+
+	file = fopen("/proc/self/mountinfo", "r");
+	if (!file)
+		return;
+
+	while (getline(&line, &n, file) != -1) {
+		char mount_point[PATH_MAX], fs_type[64], fs_source[256];
+		unsigned int dev_major, dev_minor;
+		size_t len;
+		char *sep;
+
+		if (sscanf(line, "%*d %*d %u:%u %*s %4095s", &dev_major,
+			   &dev_minor, mount_point) != 3 ||
+		    dev_major != major(st.st_dev) || dev_minor != minor(st.st_dev))
+			continue;
+		sep = strstr(line, " - ");
+		if (!sep || sscanf(sep, " - %63s %255s", fs_type, fs_source) != 2)
+			continue;
+
+		len = strlen(mount_point);
+		if (strncmp(fs->directory, mount_point, len) != 0 ||
+		    (len > 1 && fs->directory[len] != '/' &&
+		     fs->directory[len] != '\0'))
+			len = 0;
+		if (!fs->mount_point[0] || len > best) {
+			best = len;
+			strcpy(fs->mount_point, mount_point);
+			strcpy(fs->type, fs_type);
+			strcpy(fs->source, fs_source);
+		}
+	}
+
+	free(line);
+	fclose(file);
+#endif
+}
+
+static void collect_filesystem(const char *path, int dirfd,
+			       struct filesystem_info *fs)
+{
+	if (!realpath(path, fs->directory))
+		strcpy(fs->directory, "unknown");
+	strcpy(fs->type, "unknown");
+	strcpy(fs->source, "unknown");
+	find_filesystem(dirfd, fs);
+}
+
+int collect_metadata(struct run_metadata *meta, long seed, int num_threads)
+{
+	time_t now = time(NULL);
+	struct tm tm;
+	int dirfd;
+
+	memset(meta, 0, sizeof(*meta));
+	meta->seed = seed;
+	meta->num_threads = num_threads;
+	strftime(meta->start_time, sizeof(meta->start_time),
+		 "%Y-%m-%dT%H:%M:%SZ", gmtime_r(&now, &tm));
+	if (gethostname(meta->hostname, sizeof(meta->hostname) - 1) == -1)
+		strcpy(meta->hostname, "unknown");
+	if (uname(&meta->uts) == -1)
+		perror("uname");
+
+	dirfd = open(".", O_RDONLY | O_DIRECTORY);
+	collect_filesystem(".", dirfd, &meta->cwd);
+	if (dirfd != -1)
+		close(dirfd);
+
+	meta->targets = calloc(num_targets, sizeof(meta->targets[0]));
+	if (num_targets && !meta->targets) {
+		perror("calloc");
+		return -1;
+	}
+	meta->num_targets = num_targets;
+	for (unsigned int i = 0; i < num_targets; i++) {
+		collect_filesystem(targets[i].path, targets[i].dirfd,
+				   &meta->targets[i]);
+	}
+	return 0;
+}
+
+void free_metadata(struct run_metadata *meta)
+{
+	free(meta->targets);
+	for (unsigned int i = 0; meta->agents && i < meta->num_agents; i++)
+		free(meta->agents[i].targets);
+	free(meta->agents);
+}
+
+static void json_param(const char *key, enum param_type type,
+		       const char *value, void *arg)
+{
+	FILE *file = arg;
+
+	fprintf(file, ",\n    ");
+	json_write_string(file, key);
+	fprintf(file, ": ");
+	if (type == PARAM_STRING)
+		json_write_string(file, value);
+	else
+		fprintf(file, "%s", value);
+}
+
+static void json_filesystem(FILE *file, const struct filesystem_info *fs)
+{
+	fprintf(file, "{\"type\": ");
+	json_write_string(file, fs->type);
+	fprintf(file, ", \"source\": ");
+	json_write_string(file, fs->source);
+	fprintf(file, ", \"mount_point\": ");
+	json_write_string(file, fs->mount_point);
+	fprintf(file, "}");
+}
+
+static void json_metadata(FILE *file, const struct run_metadata *meta)
+{
+	fprintf(file, "  \"metadata\": {\n");
+	fprintf(file, "    \"start_time\": ");
+	json_write_string(file, meta->start_time);
+	fprintf(file, ",\n    \"seed\": %ld,\n", meta->seed);
+	fprintf(file, "    \"threads\": %d,\n", meta->num_threads);
+	fprintf(file, "    \"hostname\": ");
+	json_write_string(file, meta->hostname);
+	fprintf(file, ",\n    \"kernel\": {\"sysname\": ");
+	json_write_string(file, meta->uts.sysname);
+	fprintf(file, ", \"release\": ");
+	json_write_string(file, meta->uts.release);
+	fprintf(file, ", \"version\": ");
+	json_write_string(file, meta->uts.version);
+	fprintf(file, ", \"machine\": ");
+	json_write_string(file, meta->uts.machine);
+	fprintf(file, "},\n    \"directory\": ");
+	json_write_string(file, meta->cwd.directory);
+	fprintf(file, ",\n    \"filesystem\": ");
+	json_filesystem(file, &meta->cwd);
+	fprintf(file, ",\n    \"targets\": [");
+	for (unsigned int i = 0; i < meta->num_targets; i++) {
+		fprintf(file, "%s\n      {\"path\": ", i ? "," : "");
+		json_write_string(file, targets[i].path);
+		fprintf(file, ", \"directory\": ");
+		json_write_string(file, meta->targets[i].directory);
+		fprintf(file, ", \"filesystem\": ");
+		json_filesystem(file, &meta->targets[i]);
+		fprintf(file, "}");
+	}
+	fprintf(file, "\n    ]");
+	if (meta->agents) {
+		fprintf(file, ",\n    \"agents\": [");
+		for (unsigned int i = 0; i < meta->num_agents; i++) {
+			fprintf(file, "%s\n      {\"address\": ", i ? "," : "");
+			json_write_string(file, meta->agents[i].address);
+			fprintf(file, ", \"hostname\": ");
+			json_write_string(file, meta->agents[i].hostname);
+			fprintf(file, ", \"first_thread\": %d, \"threads\": %d",
+				meta->agents[i].first_thread,
+				meta->agents[i].num_threads);
+			fprintf(file, ", \"targets\": [");
+			for (unsigned int j = 0; j < meta->agents[i].num_targets;
+			     j++) {
+				const struct filesystem_info *fs =
+					&meta->agents[i].targets[j];
+
+				fprintf(file, "%s{\"directory\": ", j ? ", " : "");
+				json_write_string(file, fs->directory);
+				fprintf(file, ", \"filesystem\": ");
+				json_filesystem(file, fs);
+				fprintf(file, "}");
+			}
+			fprintf(file, "]}");
+		}
+		fprintf(file, "\n    ]");
+	}
+	fprintf(file, "\n  },\n");
+}
+
+static void json_histogram(FILE *file, const struct histogram *hist)
+{
+	bool first = true;
+
+	fprintf(file, "{\"count\": %llu, \"sum\": %llu, \"min\": %llu, \"max\": %llu",
+		(unsigned long long)hist->count, (unsigned long long)hist->sum,
+		(unsigned long long)hist->min, (unsigned long long)hist->max);
+	for (size_t i = 0; i < NUM_PERCENTILES; i++) {
+		fprintf(file, ", \"%s\": %llu", percentile_names[i],
+			(unsigned long long)histogram_percentile(hist, percentiles[i]));
+	}
+	fprintf(file, ", \"buckets\": [");
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		if (!hist->buckets[i])
+			continue;
+		fprintf(file, "%s[%llu, %llu]", first ? "" : ", ",
+			(unsigned long long)histogram_bucket_value(i),
+			(unsigned long long)hist->buckets[i]);
+		first = false;
+	}
+	fprintf(file, "]}");
+}
+
+static void json_results(FILE *file, const struct benchmark_results *results,
+			 double elapsed_secs, const char *indent)
+{
+	fprintf(file, "{\n");
+	fprintf(file, "%s  \"elapsed_seconds\": %.9f,\n", indent, elapsed_secs);
+	fprintf(file, "%s  \"operations\": %lu,\n", indent,
+		total_operations(results));
+	fprintf(file, "%s  \"operations_per_second\": %.3f,\n", indent,
+		total_operations(results) / elapsed_secs);
+	fprintf(file, "%s  \"operation_counts\": {", indent);
+	for (int i = 0; i < NUM_OPS; i++) {
+		fprintf(file, "%s\"%s\": %lu", i ? ", " : "", operation_names[i],
+			operation_count(results, i));
+	}
+	fprintf(file, "},\n");
+	fprintf(file, "%s  \"bytes_read\": %zu,\n", indent, results->bytes_read);
+	fprintf(file, "%s  \"bytes_written\": %zu,\n", indent,
+		results->bytes_written);
+	fprintf(file, "%s  \"readdir_entries\": %lu,\n", indent,
+		results->readdir_entries);
+	fprintf(file, "%s  \"read_syscalls\": %lu,\n", indent,
+		results->read_syscalls);
+	fprintf(file, "%s  \"write_syscalls\": %lu,\n", indent,
+		results->write_syscalls);
+	fprintf(file, "%s  \"nowait_retries\": %lu,\n", indent,
+		results->nowait_retries);
+	fprintf(file, "%s  \"bytes_copied\": %zu,\n", indent,
+		results->bytes_copied);
+	fprintf(file, "%s  \"bytes_cloned\": %zu,\n", indent,
+		results->bytes_cloned);
+	fprintf(file, "%s  \"copy_fallbacks\": %lu,\n", indent,
+		results->copy_fallbacks);
+	fprintf(file, "%s  \"clone_fallbacks\": %lu,\n", indent,
+		results->clone_fallbacks);
+	if (verify) {
+		fprintf(file, "%s  \"bytes_verified\": %zu,\n", indent,
+			results->bytes_verified);
+		fprintf(file, "%s  \"verify_errors\": %lu,\n", indent,
+			results->verify_errors);
+		fprintf(file, "%s  \"checksum_seconds\": %.9f,\n", indent,
+			results->checksum_nsecs / 1000000000.0);
+	}
+	if (hot_files) {
+		fprintf(file, "%s  \"hot_appends\": %lu,\n", indent,
+			results->hot_appends);
+		fprintf(file, "%s  \"hot_updates\": %lu,\n", indent,
+			results->hot_updates);
+		fprintf(file, "%s  \"lock_wait_ns\": ", indent);
+		json_histogram(file, &results->lock_wait);
+		fprintf(file, ",\n%s  \"hot_io_latency_ns\": ", indent);
+		json_histogram(file, &results->hot_io_latency);
+		fprintf(file, ",\n");
+	}
+	fprintf(file, "%s  \"file_sizes\": ", indent);
+	json_histogram(file, &results->file_sizes);
+	fprintf(file, ",\n%s  \"write_sizes\": ", indent);
+	json_histogram(file, &results->write_sizes);
+	fprintf(file, ",\n%s  \"initial_file_sizes\": ", indent);
+	json_histogram(file, &results->initial_file_sizes);
+	fprintf(file, ",\n%s  \"latency_ns\": {", indent);
+	for (int i = 0; i < NUM_OPS; i++) {
+		fprintf(file, "%s\n%s    \"%s\": ", i ? "," : "", indent,
+			operation_names[i]);
+		json_histogram(file, &results->latency[i]);
+	}
+	fprintf(file, "\n%s  }\n%s}", indent, indent);
+}
+
+static void json_cleanup(FILE *file, const struct cleanup_results *results)
+{
+	double elapsed_secs = elapsed_seconds(&results->elapsed_time);
+
+	fprintf(file, "{\n");
+	fprintf(file, "    \"elapsed_seconds\": %.9f,\n", elapsed_secs);
+	fprintf(file, "    \"unlink_operations\": %lu,\n",
+		results->unlink_operations);
+	fprintf(file, "    \"unlinks_per_second\": %.3f,\n",
+		results->unlink_operations / elapsed_secs);
+	fprintf(file, "    \"rmdir_operations\": %lu,\n",
+		results->rmdir_operations);
+	fprintf(file, "    \"latency_ns\": ");
+	json_histogram(file, &results->latency);
+	fprintf(file, "\n  }");
+}
+
+static void json_summary(FILE *file, const struct trial_summary *summary)
+{
+	fprintf(file, "{\"n\": %zu, \"mean\": %.3f, \"stddev\": %.3f, \"min\": %.3f, \"max\": %.3f, \"ci95\": %.3f}",
+		summary->stats.n, summary->stats.mean, summary->stats.stddev,
+		summary->stats.min, summary->stats.max, summary->ci);
+}
+
+static void json_trials(FILE *file, const struct benchmark_results *trials,
+			int num_trials, int num_threads)
+{
+	struct trial_summary summary;
+	bool first = true;
+
+	fprintf(file, "{\n    \"count\": %d,\n", num_trials);
+	fprintf(file, "    \"operations_per_second\": [");
+	for (int i = 0; i < num_trials; i++) {
+		fprintf(file, "%s%.3f", i ? ", " : "",
+			trial_rate(&trials[i], num_threads));
+	}
+	fprintf(file, "],\n    \"throughput\": ");
+	trial_throughput(&summary, trials, num_trials, num_threads);
+	json_summary(file, &summary);
+
+	fprintf(file, ",\n    \"latency_ns\": {");
+	for (int i = 0; i < NUM_OPS; i++) {
+		trial_latency(&summary, trials, num_trials, i,
+			      trial_percentiles[0]);
+		if (summary.stats.n == 0)
+			continue;
+		fprintf(file, "%s\n      \"%s\": {", first ? "" : ",",
+			operation_names[i]);
+		for (int j = 0; j < NUM_TRIAL_PERCENTILES; j++) {
+			trial_latency(&summary, trials, num_trials, i,
+				      trial_percentiles[j]);
+			fprintf(file, "%s\"%s\": ", j ? ", " : "",
+				trial_percentile_names[j]);
+			json_summary(file, &summary);
+		}
+		fprintf(file, "}");
+		first = false;
+	}
+	fprintf(file, "\n    }\n  }");
+}
+
+void json_report(FILE *file, const struct run_results *run)
+{
+	const struct run_metadata *meta = run->meta;
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"format\": \"omark-results\",\n");
+	fprintf(file, "  \"version\": 1,\n");
+	json_metadata(file, meta);
+
+	fprintf(file, "  \"params\": {\n    \"threads\": %d", meta->num_threads);
+	for_each_param(json_param, file);
+	fprintf(file, "\n  },\n");
+
+	fprintf(file, "  \"threads\": [");
+	for (int i = 0; i < meta->num_threads; i++) {
+		fprintf(file, "%s\n    ", i ? "," : "");
+		json_results(file, &run->threads[i].results,
+			     elapsed_seconds(&run->threads[i].results.elapsed_time),
+			     "    ");
+	}
+	fprintf(file, "\n  ],\n");
+
+	/* Like the verbose report, rates are based on the average elapsed time. */
+	fprintf(file, "  \"total\": ");
+	json_results(file, run->total,
+		     elapsed_seconds(&run->total->elapsed_time) / meta->num_threads,
+		     "  ");
+
+	if (run->targets) {
+		fprintf(file, ",\n  \"targets\": [");
+		for (unsigned int i = 0; i < meta->num_targets; i++) {
+			fprintf(file, "%s\n    ", i ? "," : "");
+			json_results(file, &run->targets[i],
+				     elapsed_seconds(&run->targets[i].elapsed_time) /
+				     meta->num_threads, "    ");
+		}
+		fprintf(file, "\n  ]");
+	}
+
+	if (run->num_trials > 1) {
+		fprintf(file, ",\n  \"trials\": ");
+		json_trials(file, run->trials, run->num_trials,
+			    meta->num_threads);
+	}
+
+	if (run->cleanup) {
+		fprintf(file, ",\n  \"cleanup\": ");
+		json_cleanup(file, run->cleanup);
+	}
+	fprintf(file, "\n}\n");
+}
+
+static void csv_param(const char *key, enum param_type type,
+		      const char *value, void *arg)
+{
+	fprintf(arg, "# %s=%s\n", key, value);
+}
+
+/* Average, percentiles, and maximum of a latency histogram. */
+static void csv_histogram(FILE *file, const struct histogram *hist)
+{
+	fprintf(file, ",%.0f",
+		hist->count ? (double)hist->sum / hist->count : 0.0);
+	for (size_t j = 0; j < NUM_PERCENTILES; j++) {
+		fprintf(file, ",%llu", (unsigned long long)
+			histogram_percentile(hist, percentiles[j]));
+	}
+	fprintf(file, ",%llu", (unsigned long long)hist->max);
+}
+
+static void csv_histogram_header(FILE *file, const char *name)
+{
+	fprintf(file, ",%s_avg_ns", name);
+	for (size_t j = 0; j < NUM_PERCENTILES; j++)
+		fprintf(file, ",%s_%s_ns", name, percentile_names[j]);
+	fprintf(file, ",%s_max_ns", name);
+}
+
+static void csv_row(FILE *file, const char *name,
+		    const struct benchmark_results *results,
+		    double elapsed_secs)
+{
+	fprintf(file, "%s,%.9f,%lu,%.3f", name, elapsed_secs,
+		total_operations(results),
+		total_operations(results) / elapsed_secs);
+	for (int i = 0; i < NUM_OPS; i++)
+		fprintf(file, ",%lu", operation_count(results, i));
+	fprintf(file, ",%zu,%zu,%lu", results->bytes_read,
+		results->bytes_written, results->readdir_entries);
+	fprintf(file, ",%lu,%lu,%lu", results->read_syscalls,
+		results->write_syscalls, results->nowait_retries);
+	fprintf(file, ",%zu,%zu,%lu,%lu", results->bytes_copied,
+		results->bytes_cloned, results->copy_fallbacks,
+		results->clone_fallbacks);
+	if (verify) {
+		fprintf(file, ",%zu,%lu,%.9f", results->bytes_verified,
+			results->verify_errors,
+			results->checksum_nsecs / 1000000000.0);
+	}
+	if (hot_files) {
+		fprintf(file, ",%lu,%lu", results->hot_appends,
+			results->hot_updates);
+	}
+	for (int i = 0; i < NUM_OPS; i++)
+		csv_histogram(file, &results->latency[i]);
+	if (hot_files) {
+		csv_histogram(file, &results->lock_wait);
+		csv_histogram(file, &results->hot_io_latency);
+	}
+	fprintf(file, "\n");
+}
+
+void csv_report(FILE *file, const struct run_results *run)
+{
+	const struct run_metadata *meta = run->meta;
+	char name[32];
+
+	fprintf(file, "# start_time=%s\n", meta->start_time);
+	fprintf(file, "# seed=%ld\n", meta->seed);
+	fprintf(file, "# threads=%d\n", meta->num_threads);
+	fprintf(file, "# hostname=%s\n", meta->hostname);
+	fprintf(file, "# kernel=%s %s %s %s\n", meta->uts.sysname,
+		meta->uts.release, meta->uts.version, meta->uts.machine);
+	fprintf(file, "# directory=%s\n", meta->cwd.directory);
+	fprintf(file, "# filesystem=%s %s %s\n", meta->cwd.type,
+		meta->cwd.source, meta->cwd.mount_point);
+	for (unsigned int i = 0; i < meta->num_targets; i++) {
+		fprintf(file, "# target%u=%s %s %s %s\n", i,
+			meta->targets[i].directory, meta->targets[i].type,
+			meta->targets[i].source, meta->targets[i].mount_point);
+	}
+	for (unsigned int i = 0; meta->agents && i < meta->num_agents; i++) {
+		fprintf(file, "# agent%u=%s %s %d %d\n", i,
+			meta->agents[i].address, meta->agents[i].hostname,
+			meta->agents[i].first_thread,
+			meta->agents[i].num_threads);
+		for (unsigned int j = 0; j < meta->agents[i].num_targets; j++) {
+			const struct filesystem_info *fs =
+				&meta->agents[i].targets[j];
+
+			fprintf(file, "# agent%u_target%u=%s %s %s %s\n", i, j,
+				fs->directory, fs->type, fs->source,
+				fs->mount_point);
+		}
+	}
+	for_each_param(csv_param, file);
+	if (run->cleanup) {
+		fprintf(file, "# cleanup_elapsed_seconds=%.9f\n",
+			elapsed_seconds(&run->cleanup->elapsed_time));
+		fprintf(file, "# cleanup_unlink_operations=%lu\n",
+			run->cleanup->unlink_operations);
+		fprintf(file, "# cleanup_rmdir_operations=%lu\n",
+			run->cleanup->rmdir_operations);
+	}
+
+	fprintf(file, "%s,elapsed_seconds,operations,operations_per_second",
+		run->num_trials > 1 ? "trial" : "thread");
+	for (int i = 0; i < NUM_OPS; i++)
+		fprintf(file, ",%s_operations", operation_names[i]);
+	fprintf(file, ",bytes_read,bytes_written,readdir_entries");
+	fprintf(file, ",read_syscalls,write_syscalls,nowait_retries");
+	fprintf(file, ",bytes_copied,bytes_cloned,copy_fallbacks,clone_fallbacks");
+	if (verify)
+		fprintf(file, ",bytes_verified,verify_errors,checksum_seconds");
+	if (hot_files)
+		fprintf(file, ",hot_appends,hot_updates");
+	for (int i = 0; i < NUM_OPS; i++) {
+		snprintf(name, sizeof(name), "%s_latency", operation_names[i]);
+		csv_histogram_header(file, name);
+	}
+	if (hot_files) {
+		csv_histogram_header(file, "lock_wait");
+		csv_histogram_header(file, "hot_io_latency");
+	}
+	fprintf(file, "\n");
+
+	if (run->num_trials > 1) {
+		for (int i = 0; i < run->num_trials; i++) {
+			snprintf(name, sizeof(name), "%d", i);
+			csv_row(file, name, &run->trials[i],
+				elapsed_seconds(&run->trials[i].elapsed_time) /
+				meta->num_threads);
+		}
+	} else {
+		for (int i = 0; i < meta->num_threads; i++) {
+			const struct benchmark_results *results;
+
+			results = &run->threads[i].results;
+			snprintf(name, sizeof(name), "%d", i);
+			csv_row(file, name, results,
+				elapsed_seconds(&results->elapsed_time));
+		}
+		csv_row(file, "total", run->total,
+			elapsed_seconds(&run->total->elapsed_time) /
+			meta->num_threads);
+	}
+
+	for (unsigned int i = 0; run->targets && i < meta->num_targets; i++) {
+		snprintf(name, sizeof(name), "target%u", i);
+		csv_row(file, name, &run->targets[i],
+			elapsed_seconds(&run->targets[i].elapsed_time) /
+			meta->num_threads);
+	}
+}
@@ -0,0 +1,165 @@
+/*
+ * Structured (JSON and CSV) benchmark reports.
+ */
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <limits.h>
+#include <stdio.h>
+#include <sys/utsname.h>
+#include "benchmark.h"
+#include "stats.h"
+
+/* A directory and the filesystem containing it. */
+struct filesystem_info {
+	char directory[PATH_MAX];
+	char type[64];
+	char source[256];
+	char mount_point[PATH_MAX];
+};
+
+/* An agent which ran some of the threads for a controller. */
+struct agent_info {
+	char address[256];
+	char hostname[256];
+	int first_thread;
+	int num_threads;
+	/* Target directories on the agent. */
+	struct filesystem_info *targets;
+	unsigned int num_targets;
+};
+
+/* Information about a run which isn't a benchmark parameter. */
+struct run_metadata {
+	char start_time[32];
+	long seed;
+	int num_threads;
+	char hostname[256];
+	struct utsname uts;
+	/* Working directory. */
+	struct filesystem_info cwd;
+	/*
+	 * Target directories, in the same order as the targets array; none
+	 * with agents, which have their own.
+	 */
+	struct filesystem_info *targets;
+	unsigned int num_targets;
+	/* Agents which ran the threads, or NULL if they ran locally. */
+	struct agent_info *agents;
+	unsigned int num_agents;
+};
+
+/* Everything that goes into a report. */
+struct run_results {
+	const struct run_metadata *meta;
+	const struct benchmark_thread *threads;
+	/* Results of all threads added together. */
+	const struct benchmark_results *total;
+	/*
+	 * Results of all threads added together for each trial. If there was
+	 * more than one, threads, total, and targets are of the last trial.
+	 */
+	const struct benchmark_results *trials;
+	int num_trials;
+	/* Results of all threads on each target, or NULL if there is one. */
+	const struct benchmark_results *targets;
+	/* Results of the cleanup phase added together, or NULL if there was none. */
+	const struct cleanup_results *cleanup;
+};
+
+/* Latency percentiles which are summarized over repeated trials. */
+#define NUM_TRIAL_PERCENTILES 3
+extern const double trial_percentiles[NUM_TRIAL_PERCENTILES];
+extern const char * const trial_percentile_names[NUM_TRIAL_PERCENTILES];
+
+/* Summary of a metric over repeated trials. */
+struct trial_summary {
+	struct sample_stats stats;
+	/* Half-width of the 95% confidence interval of the mean; 0 if n < 2. */
+	double ci;
+};
+
+/**
+ * collect_metadata - fill in the metadata for a run, which must be called from
+ * the benchmark working directory after the targets have been added
+ * @meta: metadata to fill in
+ * @seed: PRNG seed
+ * @num_threads: number of benchmark threads
+ *
+ * Returns 0 on success or -1 on error.
+ */
+int collect_metadata(struct run_metadata *meta, long seed, int num_threads);
+
+/**
+ * free_metadata - free the memory allocated for the metadata
+ * @meta: metadata to free
+ */
+void free_metadata(struct run_metadata *meta);
+
+/**
+ * json_report - write a complete report of a run as JSON
+ * @file: file to write to
+ * @run: results of the run
+ */
+void json_report(FILE *file, const struct run_results *run);
+
+/**
+ * csv_report - write a report of a run as CSV, with one row per thread and one
+ * for the total, or one row per trial if there was more than one, followed by
+ * one row per target if there is more than one; the metadata and parameters
+ * are written first as comment lines starting with '#'
+ * @file: file to write to
+ * @run: results of the run
+ */
+void csv_report(FILE *file, const struct run_results *run);
+
+/**
+ * trial_throughput - summarize the throughput (operations per second with the
+ * average elapsed time of the threads) over repeated trials
+ * @summary: returned summary
+ * @trials: results of all threads added together for each trial
+ * @num_trials: number of trials
+ * @num_threads: number of benchmark threads
+ */
+void trial_throughput(struct trial_summary *summary,
+		      const struct benchmark_results *trials, int num_trials,
+		      int num_threads);
+
+/**
+ * trial_latency - summarize a latency percentile of an operation over repeated
+ * trials, skipping trials without any operations of that type
+ * @summary: returned summary, in nanoseconds
+ * @trials: results of all threads added together for each trial
+ * @num_trials: number of trials
+ * @op: operation type
+ * @percentile: percentile to summarize
+ */
+void trial_latency(struct trial_summary *summary,
+		   const struct benchmark_results *trials, int num_trials,
+		   enum operation op, double percentile);
+
+/**
+ * elapsed_seconds - convert an elapsed time to seconds
+ * @elapsed_time: the elapsed time
+ */
+static inline double elapsed_seconds(const struct timespec *elapsed_time)
+{
+	return elapsed_time->tv_sec + elapsed_time->tv_nsec / 1000000000.0;
+}
+
+/**
+ * operation_count - number of successful operations of a type
+ * @results: benchmark results
+ * @op: operation type
+ */
+unsigned long operation_count(const struct benchmark_results *results,
+			      enum operation op);
+
+/**
+ * total_operations - number of successful operations of any type
+ * @results: benchmark results
+ */
+unsigned long total_operations(const struct benchmark_results *results);
+
+#endif /* REPORT_H */
@@ -0,0 +1,137 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "slowlog.h"
+
+uint64_t slow_threshold_nsecs;
+
+struct timeline_entry {
+	struct slow_op op;
+	int thread;
+};
+
+void slow_log_record(struct slow_log *log, const struct slow_op *op)
+{
+	uint64_t head = log->head;
+
+	log->entries[head % SLOW_LOG_ENTRIES] = *op;
+	__atomic_store_n(&log->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void slow_log_reset(struct slow_log *log)
+{
+	__atomic_store_n(&log->head, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Copy the entries of a ring which are still there after copying. Returns the
+ * number copied and the number which were overwritten before they could be
+ * copied.
+ */
+static size_t copy_ring(const struct slow_log *log, int thread,
+			struct timeline_entry *timeline, uint64_t *lost_ret)
+{
+	uint64_t head, first, valid;
+	size_t n = 0;
+
+	head = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+	first = head > SLOW_LOG_ENTRIES ? head - SLOW_LOG_ENTRIES : 0;
+	for (uint64_t i = first; i < head; i++) {
+		timeline[i - first].op = log->entries[i % SLOW_LOG_ENTRIES];
+		timeline[i - first].thread = thread;
+	}
+
+	/*
+	 * The writer may have overwritten the oldest entries while they were
+	 * copied, including the slot of the entry it is working on.
+	 */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	valid = __atomic_load_n(&log->head, __ATOMIC_RELAXED);
+	valid = valid >= SLOW_LOG_ENTRIES ? valid - SLOW_LOG_ENTRIES + 1 : 0;
+	if (valid < first)
+		valid = first;
+	if (valid < head) {
+		n = head - valid;
+		memmove(timeline, &timeline[valid - first],
+			n * sizeof(timeline[0]));
+	}
+	*lost_ret = valid < head ? valid : head;
+	return n;
+}
+
+static int compare_entries(const void *a, const void *b)
+{
+	const struct timeline_entry *x = a, *y = b;
+
+	if (x->op.start_nsecs != y->op.start_nsecs)
+		return x->op.start_nsecs < y->op.start_nsecs ? -1 : 1;
+	return x->thread - y->thread;
+}
+
+int slow_log_dump(FILE *file, const struct benchmark_thread *threads,
+		  int num_threads, const char *title)
+{
+	struct timeline_entry *timeline;
+	struct timespec mono, real;
+	int64_t offset_nsecs;
+	uint64_t lost = 0;
+	size_t n = 0;
+
+	timeline = malloc((size_t)num_threads * SLOW_LOG_ENTRIES *
+			  sizeof(timeline[0]));
+	if (!timeline) {
+		perror("malloc");
+		return -1;
+	}
+	for (int i = 0; i < num_threads; i++) {
+		uint64_t thread_lost;
+
+		if (!threads[i].slow_log)
+			continue;
+		n += copy_ring(threads[i].slow_log, i, &timeline[n],
+			       &thread_lost);
+		lost += thread_lost;
+	}
+	qsort(timeline, n, sizeof(timeline[0]), compare_entries);
+
+	/* Wall clock time of each entry, assuming nobody steps the clock. */
+	clock_gettime(CLOCK_MONOTONIC, &mono);
+	clock_gettime(CLOCK_REALTIME, &real);
+	offset_nsecs = ((real.tv_sec - mono.tv_sec) * INT64_C(1000000000) +
+			(real.tv_nsec - mono.tv_nsec));
+
+	fprintf(file, "# Slow operations (at least %g us) %s: %zu",
+		slow_threshold_nsecs / 1000.0, title, n);
+	if (lost)
+		fprintf(file, ", %llu older ones overwritten",
+			(unsigned long long)lost);
+	fprintf(file, "\n");
+	fprintf(file, "# monotonic\twall_clock\tthread\ttarget\top\tfile\tsize\tlatency_us\n");
+	for (size_t i = 0; i < n; i++) {
+		const struct slow_op *op = &timeline[i].op;
+		uint64_t wall = op->start_nsecs + offset_nsecs;
+		time_t wall_secs = wall / 1000000000;
+		char wall_str[32];
+		struct tm tm;
+
+		strftime(wall_str, sizeof(wall_str), "%Y-%m-%dT%H:%M:%S",
+			 gmtime_r(&wall_secs, &tm));
+		fprintf(file, "%llu.%09llu\t%s.%06lluZ\t%d\t%u\t%s\t",
+			(unsigned long long)(op->start_nsecs / 1000000000),
+			(unsigned long long)(op->start_nsecs % 1000000000),
+			wall_str,
+			(unsigned long long)(wall % 1000000000 / 1000),
+			timeline[i].thread, op->target,
+			operation_names[op->op]);
+		if (op->file_id >= 0)
+			fprintf(file, "%lld", (long long)op->file_id);
+		else
+			fprintf(file, "-");
+		fprintf(file, "\t%llu\t%.3f\n", (unsigned long long)op->size,
+			op->latency_nsecs / 1000.0);
+	}
+	fflush(file);
+
+	free(timeline);
+	return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Log of slow operations for tail latency forensics.
+ *
+ * Each thread has a fixed-size ring of the most recent operations which took
+ * at least the threshold, allocated before the benchmark starts so that
+ * recording never allocates. The ring has a single writer, its thread, which
+ * fills in an entry and then publishes it by advancing the head; a reader
+ * copies the entries and discards the ones which the writer may have
+ * overwritten in the meantime.
+ */
+
+#ifndef SLOWLOG_H
+#define SLOWLOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "benchmark.h"
+
+/* Number of entries in each thread's ring. */
+#define SLOW_LOG_ENTRIES 4096
+
+struct slow_op {
+	/* CLOCK_MONOTONIC time when the operation started. */
+	uint64_t start_nsecs;
+	uint64_t latency_nsecs;
+	/* Id of the file, or -1 if the operation wasn't on a single file. */
+	int64_t file_id;
+	/* Bytes read, written, copied, or cloned. */
+	uint64_t size;
+	uint32_t op;
+	uint32_t target;
+};
+
+struct slow_log {
+	/* Number of operations ever recorded. */
+	uint64_t head;
+	struct slow_op entries[SLOW_LOG_ENTRIES];
+};
+
+/* Smallest latency in nanoseconds which is logged, or 0 if disabled. */
+extern uint64_t slow_threshold_nsecs;
+
+/**
+ * slow_log_record - add an operation to a thread's ring, overwriting the
+ * oldest entry if it is full
+ * @log: the thread's ring
+ * @op: the operation
+ */
+void slow_log_record(struct slow_log *log, const struct slow_op *op);
+
+/**
+ * slow_log_reset - empty a thread's ring
+ * @log: the thread's ring
+ */
+void slow_log_reset(struct slow_log *log);
+
+/**
+ * slow_log_dump - write the slow operations of all threads as a timeline
+ * sorted by start time
+ * @file: file to write to
+ * @threads: benchmark threads
+ * @num_threads: number of benchmark threads
+ * @title: description of when the dump was taken
+ */
+int slow_log_dump(FILE *file, const struct benchmark_thread *threads,
+		  int num_threads, const char *title);
+
+#endif /* SLOWLOG_H */
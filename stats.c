@@ -0,0 +1,87 @@
+#include <math.h>
+#include <stdbool.h>
+#include "stats.h"
+
+void sample_stats(struct sample_stats *stats, const double *values, size_t n)
+{
+	double sum = 0.0, sum_squares = 0.0;
+
+	stats->n = n;
+	stats->mean = stats->stddev = stats->min = stats->max = 0.0;
+	if (n == 0)
+		return;
+
+	stats->min = stats->max = values[0];
+	for (size_t i = 0; i < n; i++) {
+		sum += values[i];
+		if (values[i] < stats->min)
+			stats->min = values[i];
+		if (values[i] > stats->max)
+			stats->max = values[i];
+	}
+	stats->mean = sum / n;
+
+	if (n < 2)
+		return;
+	for (size_t i = 0; i < n; i++)
+		sum_squares += (values[i] - stats->mean) * (values[i] - stats->mean);
+	stats->stddev = sqrt(sum_squares / (n - 1));
+}
+
+/* 95th and 97.5th percentiles of Student's t-distribution for 1-30 df. */
+static const double t_95[] = {
+	6.314, 2.920, 2.353, 2.132, 2.015, 1.943, 1.895, 1.860, 1.833, 1.812,
+	1.796, 1.782, 1.771, 1.761, 1.753, 1.746, 1.740, 1.734, 1.729, 1.725,
+	1.721, 1.717, 1.714, 1.711, 1.708, 1.706, 1.703, 1.701, 1.699, 1.697,
+};
+
+static const double t_975[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+double t_critical(double df, bool two_sided)
+{
+	int n = df < 1.0 ? 1 : (int)df;
+
+	if (n <= 30)
+		return two_sided ? t_975[n - 1] : t_95[n - 1];
+	/* Beyond the table, the first Cornish-Fisher term is close enough. */
+	if (two_sided)
+		return 1.959964 + (1.959964 * 1.959964 * 1.959964 + 1.959964) / (4.0 * n);
+	return 1.644854 + (1.644854 * 1.644854 * 1.644854 + 1.644854) / (4.0 * n);
+}
+
+double confidence_interval(const struct sample_stats *stats)
+{
+	return t_critical(stats->n - 1, true) * stats->stddev / sqrt(stats->n);
+}
+
+double welch_t(const struct sample_stats *a, const struct sample_stats *b,
+	       double *df_ret)
+{
+	double va = a->stddev * a->stddev / a->n;
+	double vb = b->stddev * b->stddev / b->n;
+
+	if (va + vb == 0.0) {
+		*df_ret = a->n + b->n - 2;
+		if (a->mean == b->mean)
+			return 0.0;
+		return a->mean > b->mean ? INFINITY : -INFINITY;
+	}
+	*df_ret = ((va + vb) * (va + vb) /
+		   (va * va / (a->n - 1) + vb * vb / (b->n - 1)));
+	return (a->mean - b->mean) / sqrt(va + vb);
+}
+
+double proportion_z(double hits0, double n0, double hits1, double n1)
+{
+	double p0 = hits0 / n0, p1 = hits1 / n1;
+	double p = (hits0 + hits1) / (n0 + n1);
+	double se = sqrt(p * (1.0 - p) * (1.0 / n0 + 1.0 / n1));
+
+	if (se == 0.0)
+		return 0.0;
+	return (p1 - p0) / se;
+}
@@ -0,0 +1,67 @@
+/*
+ * Statistics for comparing and summarizing benchmark results.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct sample_stats {
+	size_t n;
+	double mean;
+	/* Sample standard deviation; 0 if n < 2. */
+	double stddev;
+	double min, max;
+};
+
+/**
+ * sample_stats - compute summary statistics of a sample
+ * @stats: returned statistics
+ * @values: the sample
+ * @n: number of values in the sample
+ */
+void sample_stats(struct sample_stats *stats, const double *values, size_t n);
+
+/**
+ * t_critical - critical value of Student's t-distribution
+ * @df: degrees of freedom (may be fractional; rounded down)
+ * @two_sided: true for a two-sided 95% interval (the 97.5th percentile), false
+ * for a one-sided 95% test (the 95th percentile)
+ */
+double t_critical(double df, bool two_sided);
+
+/**
+ * confidence_interval - half-width of the 95% confidence interval of the mean
+ * @stats: statistics of the sample, which must have n >= 2
+ */
+double confidence_interval(const struct sample_stats *stats);
+
+/**
+ * welch_t - Welch's t-test of whether two samples have different means
+ * @a: statistics of the first sample
+ * @b: statistics of the second sample
+ * @df_ret: returned degrees of freedom
+ *
+ * Returns the t statistic (positive if the mean of a is greater); both samples
+ * must have n >= 2.
+ */
+double welch_t(const struct sample_stats *a, const struct sample_stats *b,
+	       double *df_ret);
+
+/**
+ * proportion_z - one-sided two-proportion z-test
+ * @hits0: successes in the first sample
+ * @n0: size of the first sample
+ * @hits1: successes in the second sample
+ * @n1: size of the second sample
+ *
+ * Returns the z statistic (positive if the second proportion is greater).
+ */
+double proportion_z(double hits0, double n0, double hits1, double n1);
+
+/* Critical value of the standard normal distribution for a one-sided 95% test. */
+#define Z_CRITICAL 1.6448536269514722
+
+#endif /* STATS_H */